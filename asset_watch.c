@@ -0,0 +1,195 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "asset_watch.h"
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+static void mark_changed(AssetWatch* watch, int wd, const char* name)
+{
+    pthread_mutex_lock(&watch->lock);
+    watch->events++;
+    for (int i = 0; i < watch->asset_count; ++i)
+    {
+        WatchedAsset* asset = &watch->assets[i];
+        if (watch->dir_watches[asset->dir] != wd || strcmp(asset->name, name) != 0 || asset->changed)
+            continue;
+        asset->changed = true;
+        atomic_fetch_add_explicit(&watch->pending, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&watch->lock);
+}
+
+static void* watch_thread(void* arg)
+{
+    AssetWatch* watch = arg;
+    // inotify_event has a flexible name, keep the buffer aligned for it
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {.fd = watch->inotify_fd, .events = POLLIN},
+        {.fd = watch->wake_pipe[0], .events = POLLIN},
+    };
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error waiting for asset changes");
+            break;
+        }
+        if (fds[1].revents)
+            break;
+
+        ssize_t length = read(watch->inotify_fd, buffer, sizeof(buffer));
+        if (length < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            perror("Error reading asset changes");
+            break;
+        }
+        for (char* c = buffer; c < buffer + length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*) c;
+            if (event->len > 0)
+                mark_changed(watch, event->wd, event->name);
+            c += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return NULL;
+}
+
+bool asset_watch_init(AssetWatch* watch)
+{
+    *watch = (AssetWatch) {.inotify_fd = -1, .wake_pipe = {-1, -1}};
+    if ((watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+    {
+        perror("Error starting inotify");
+        return false;
+    }
+    if (pipe(watch->wake_pipe) != 0)
+    {
+        perror("Error creating asset watch pipe");
+        close(watch->inotify_fd);
+        return false;
+    }
+    pthread_mutex_init(&watch->lock, NULL);
+    if (pthread_create(&watch->thread, NULL, watch_thread, watch) != 0)
+    {
+        perror("Error starting asset watch thread");
+        asset_watch_shutdown(watch);
+        return false;
+    }
+    watch->running = true;
+    return true;
+}
+
+static int find_dir(AssetWatch* watch, const char* dir)
+{
+    for (int i = 0; i < watch->dir_count; ++i)
+    {
+        if (strcmp(watch->dirs[i], dir) == 0)
+            return i;
+    }
+    if (watch->dir_count == ASSET_WATCH_MAX_DIRS)
+    {
+        printf("Error watching %s: too many directories\n", dir);
+        return -1;
+    }
+    int wd = inotify_add_watch(watch->inotify_fd, dir, WATCH_EVENTS);
+    if (wd < 0)
+    {
+        perror("Error watching asset directory");
+        return -1;
+    }
+    snprintf(watch->dirs[watch->dir_count], ASSET_WATCH_PATH_MAX, "%s", dir);
+    watch->dir_watches[watch->dir_count] = wd;
+    return watch->dir_count++;
+}
+
+static bool add_locked(AssetWatch* watch, const char* path, int tag)
+{
+    for (int i = 0; i < watch->asset_count; ++i)
+    {
+        if (strcmp(watch->assets[i].path, path) == 0)
+            return true;
+    }
+    if (watch->asset_count == ASSET_WATCH_MAX_ASSETS)
+    {
+        printf("Error watching %s: too many assets\n", path);
+        return false;
+    }
+
+    // files are watched through their directory, a file watch dies with the inode when an editor renames over it
+    char dir[ASSET_WATCH_PATH_MAX];
+    const char* slash = strrchr(path, '/');
+    if (slash)
+        snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int) (slash - path), path);
+    else
+        snprintf(dir, sizeof(dir), ".");
+    int dir_index = find_dir(watch, dir);
+    if (dir_index < 0)
+        return false;
+
+    WatchedAsset* asset = &watch->assets[watch->asset_count++];
+    snprintf(asset->path, sizeof(asset->path), "%s", path);
+    asset->name = slash ? asset->path + (slash - path) + 1 : asset->path;
+    asset->dir = dir_index;
+    asset->tag = tag;
+    asset->changed = false;
+    return true;
+}
+
+bool asset_watch_add(AssetWatch* watch, const char* path, int tag)
+{
+    if (strlen(path) >= ASSET_WATCH_PATH_MAX)
+        return false;
+    pthread_mutex_lock(&watch->lock);
+    bool ok = add_locked(watch, path, tag);
+    pthread_mutex_unlock(&watch->lock);
+    return ok;
+}
+
+bool asset_watch_pending(AssetWatch* watch)
+{
+    return atomic_load_explicit(&watch->pending, memory_order_acquire) > 0;
+}
+
+int asset_watch_next(AssetWatch* watch)
+{
+    int next = -1;
+    pthread_mutex_lock(&watch->lock);
+    for (int i = 0; i < watch->asset_count; ++i)
+    {
+        if (watch->assets[i].changed)
+        {
+            watch->assets[i].changed = false;
+            atomic_fetch_sub_explicit(&watch->pending, 1, memory_order_relaxed);
+            next = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&watch->lock);
+    return next;
+}
+
+void asset_watch_shutdown(AssetWatch* watch)
+{
+    if (watch->running)
+    {
+        if (write(watch->wake_pipe[1], "", 1) != 1)
+            perror("Error stopping asset watch thread");
+        pthread_join(watch->thread, NULL);
+        watch->running = false;
+    }
+    pthread_mutex_destroy(&watch->lock);
+    close(watch->wake_pipe[0]);
+    close(watch->wake_pipe[1]);
+    close(watch->inotify_fd);
+    watch->inotify_fd = watch->wake_pipe[0] = watch->wake_pipe[1] = -1;
+}
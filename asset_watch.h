@@ -0,0 +1,54 @@
+#ifndef ASSET_WATCH_H
+#define ASSET_WATCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ASSET_WATCH_MAX_ASSETS 32
+#define ASSET_WATCH_MAX_DIRS 8
+#define ASSET_WATCH_PATH_MAX 256
+
+typedef struct WatchedAsset
+{
+    char path[ASSET_WATCH_PATH_MAX];
+    const char* name; // file name part of path
+    int dir;
+    int tag;          // the caller's, handed back by asset_watch_next
+    bool changed;     // under lock
+}WatchedAsset;
+
+/* Reports assets changed on disk. A thread blocks in inotify on the
+ * directories that hold them, watching for files closed after writing or
+ * renamed into place, which covers editors that save by writing a new file
+ * and renaming it over the old one. A change marks the asset once however
+ * many events it took, and the only thing a frame pays while nothing
+ * changes is the load of pending. */
+typedef struct AssetWatch
+{
+    int inotify_fd;
+    int wake_pipe[2];
+    pthread_t thread;
+    bool running;
+
+    pthread_mutex_t lock;
+    int dir_count;
+    int dir_watches[ASSET_WATCH_MAX_DIRS];
+    char dirs[ASSET_WATCH_MAX_DIRS][ASSET_WATCH_PATH_MAX];
+    int asset_count;
+    WatchedAsset assets[ASSET_WATCH_MAX_ASSETS];
+    atomic_int pending; // assets marked changed
+    uint64_t events;    // under lock
+}AssetWatch;
+
+bool asset_watch_init(AssetWatch* watch);
+/* Watching a path twice is fine, it keeps its first tag. */
+bool asset_watch_add(AssetWatch* watch, const char* path, int tag);
+bool asset_watch_pending(AssetWatch* watch);
+/* Takes one changed asset off the queue, returns its index or -1 when
+ * there is none left. */
+int asset_watch_next(AssetWatch* watch);
+void asset_watch_shutdown(AssetWatch* watch);
+
+#endif // ASSET_WATCH_H
@@ -0,0 +1,70 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "assets.h"
+
+#ifdef ASSET_OVERRIDES
+static bool prefer_disk = true;
+#else
+static bool prefer_disk = false;
+#endif
+static AssetStats stats;
+
+static const EmbeddedAsset* find_embedded(const char* name)
+{
+    // a handful of entries, a linear scan beats anything that needs building
+    for (int i = 0; i < embedded_asset_count; ++i)
+    {
+        if (strcmp(embedded_assets[i].name, name) == 0)
+            return &embedded_assets[i];
+    }
+    return NULL;
+}
+
+static bool open_file(const char* name, Asset* asset)
+{
+    if (!map_file(name, &asset->file, FILE_ACCESS_SEQUENTIAL))
+        return false;
+    asset->data = asset->file.data;
+    asset->size = asset->file.size;
+    stats.disk_loads++;
+    return true;
+}
+
+bool asset_open(const char* name, Asset* asset)
+{
+    uint64_t start = time_now_ns();
+    *asset = (Asset) {0};
+    const EmbeddedAsset* embedded = find_embedded(name);
+    // access() first so a missing override doesn't print map_file's error
+    bool ok = (prefer_disk || !embedded) && (!embedded || access(name, R_OK) == 0) && open_file(name, asset);
+    if (!ok && embedded)
+    {
+        asset->data = (const char*) embedded->data;
+        asset->size = embedded->size;
+        asset->embedded = true;
+        stats.embedded_loads++;
+        ok = true;
+    }
+    stats.ns += time_now_ns() - start;
+    return ok;
+}
+
+void asset_close(Asset* asset)
+{
+    if (!asset->embedded && asset->data)
+        unmap_file(&asset->file);
+    *asset = (Asset) {0};
+}
+
+void asset_prefer_disk(bool prefer)
+{
+    prefer_disk = prefer;
+}
+
+void asset_get_stats(AssetStats* out)
+{
+    *out = stats;
+}
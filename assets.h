@@ -0,0 +1,51 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+/* A file compiled into the executable by embed, see EMBED_ASSETS in the
+ * makefile. data is NUL terminated, size does not count the terminator. */
+typedef struct EmbeddedAsset
+{
+    const char* name;
+    const unsigned char* data;
+    size_t size;
+}EmbeddedAsset;
+
+// generated into embedded_assets.c
+extern const EmbeddedAsset embedded_assets[];
+extern const int embedded_asset_count;
+
+/* Contents of an asset, either straight out of the executable's read-only
+ * data or from the file on disk. */
+typedef struct Asset
+{
+    const char* data;
+    size_t size;
+    bool embedded; // nothing to release
+    FileSpan file;
+}Asset;
+
+typedef struct AssetStats
+{
+    int embedded_loads;
+    int disk_loads;
+    uint64_t ns;
+}AssetStats;
+
+/* Looks name up, the path as it appears in EMBED_ASSETS. Builds with
+ * ASSET_OVERRIDES defined (the makefile's development build) read the file
+ * on disk first and only fall back to the embedded copy when there is
+ * none, so edits show up without a rebuild. Anything not embedded is read
+ * from disk either way. */
+bool asset_open(const char* name, Asset* asset);
+void asset_close(Asset* asset);
+/* Overrides on or off at run time, hot reload needs the disk copies. */
+void asset_prefer_disk(bool prefer);
+void asset_get_stats(AssetStats* stats);
+
+#endif // ASSETS_H
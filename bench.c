@@ -0,0 +1,609 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "command_buffer.h"
+#include "decode_pool.h"
+#include "geom.h"
+#include "mesh_cache.h"
+#include "mipmap.h"
+#include "pixel_convert.h"
+#include "util.h"
+
+#define IO_REPEATS 5
+#define MESH_REPEATS 3
+
+typedef struct BenchCommand
+{
+    const char* name;
+    const char* usage;
+    int (*run)(int argc, char** argv);
+}BenchCommand;
+
+static const char* default_assets[] = {
+    "vertex.glsl", "fragment.glsl",
+    "earth00.jpg", "earth01.jpg", "earth02.jpg", "earth03.jpg",
+    "smiley.jpg",
+};
+
+static double ns_to_ms(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+/* Sum every byte so both paths actually fault in / copy the whole file,
+ * the same way a decoder or glBufferData would. */
+static uint64_t touch_bytes(const char* data, size_t size)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i)
+        sum += (unsigned char) data[i];
+    return sum;
+}
+
+static void drop_page_cache(const char* file_path)
+{
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+        return;
+    // dirty pages of freshly written caches can't be dropped until flushed
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/* The previous util.c read_file: stdio buffer plus a heap copy. */
+static uint64_t load_stdio(const char* file_path)
+{
+    FILE* file = fopen(file_path, "r");
+    if (file == NULL)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    size_t file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* contents = malloc(file_size + 1);
+    size_t bytes_read = fread(contents, 1, file_size, file);
+    contents[bytes_read] = '\0';
+    fclose(file);
+
+    uint64_t sum = touch_bytes(contents, bytes_read);
+    free(contents);
+    return sum;
+}
+
+static uint64_t load_mapped(const char* file_path)
+{
+    FileSpan span;
+    if (!map_file(file_path, &span, FILE_ACCESS_WILLNEED))
+        return 0;
+    uint64_t sum = touch_bytes(span.data, span.size);
+    unmap_file(&span);
+    return sum;
+}
+
+static double time_load(uint64_t (*load)(const char*), const char* file_path, bool cold, uint64_t* checksum)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < IO_REPEATS; ++i)
+    {
+        if (cold)
+            drop_page_cache(file_path);
+        uint64_t start = time_now_ns();
+        *checksum = load(file_path);
+        uint64_t elapsed = time_now_ns() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return ns_to_ms(best);
+}
+
+static int bench_io(int argc, char** argv)
+{
+    const char** files = (const char**) argv;
+    int file_count = argc;
+    if (file_count == 0)
+    {
+        files = default_assets;
+        file_count = sizeof(default_assets) / sizeof(default_assets[0]);
+    }
+
+    printf("%-16s %10s %12s %12s %12s %12s\n", "file", "bytes", "cold stdio", "cold mmap", "warm stdio", "warm mmap");
+    for (int i = 0; i < file_count; ++i)
+    {
+        FileSpan span;
+        if (!map_file(files[i], &span, FILE_ACCESS_RANDOM))
+            continue;
+        size_t size = span.size;
+        unmap_file(&span);
+
+        uint64_t sums[4];
+        double cold_stdio = time_load(load_stdio, files[i], true, &sums[0]);
+        double cold_mapped = time_load(load_mapped, files[i], true, &sums[1]);
+        double warm_stdio = time_load(load_stdio, files[i], false, &sums[2]);
+        double warm_mapped = time_load(load_mapped, files[i], false, &sums[3]);
+        if (sums[0] != sums[1] || sums[0] != sums[2] || sums[0] != sums[3])
+        {
+            fprintf(stderr, "checksum mismatch for %s\n", files[i]);
+            return 1;
+        }
+
+        printf("%-16s %10zu %10.3fms %10.3fms %10.3fms %10.3fms\n",
+               files[i], size, cold_stdio, cold_mapped, warm_stdio, warm_mapped);
+    }
+    return 0;
+}
+
+static uint64_t touch_mesh(const MeshCache* cache)
+{
+    const MeshHeader* header = cache->header;
+    return touch_bytes(cache->vertices, (size_t) header->vertex_count * header->vertex_stride)
+        + touch_bytes(cache->indices, (size_t) header->index_count * header->index_type);
+}
+
+static int bench_mesh(int argc, char** argv)
+{
+    static const int default_resolutions[] = {32, 256, 1024, 2048};
+    int resolution_count = argc ? argc : (int) (sizeof(default_resolutions) / sizeof(default_resolutions[0]));
+
+    printf("%-10s %10s %10s %12s %12s %12s %12s\n", "sectors", "vertices", "lods", "regenerate", "build", "cold load", "warm load");
+    for (int r = 0; r < resolution_count; ++r)
+    {
+        int resolution = argc ? atoi(argv[r]) : default_resolutions[r];
+        char path[256];
+        snprintf(path, sizeof(path), MESH_CACHE_DIR "/earth_%dx%d.mesh", resolution, resolution);
+        remove(path);
+
+        uint64_t best_regen = UINT64_MAX;
+        for (int i = 0; i < MESH_REPEATS; ++i)
+        {
+            Vertex_Buffer vbuff = {0};
+            Index_Buffer ibuff = {0};
+            uint64_t start = time_now_ns();
+            make_earth_geom(&vbuff, &ibuff, resolution, resolution);
+            uint64_t elapsed = time_now_ns() - start;
+            if (elapsed < best_regen)
+                best_regen = elapsed;
+            free_vb(&vbuff);
+            free_ib(&ibuff);
+        }
+
+        MeshCache cache;
+        uint64_t start = time_now_ns();
+        if (!mesh_cache_get_earth(&cache, resolution, resolution))
+            return 1;
+        uint64_t build = time_now_ns() - start;
+        uint32_t vertex_count = cache.header->vertex_count;
+        uint32_t lod_count = cache.header->lod_count;
+        mesh_cache_close(&cache);
+
+        uint64_t best_load[2] = {UINT64_MAX, UINT64_MAX};
+        for (int cold = 1; cold >= 0; --cold)
+        {
+            for (int i = 0; i < MESH_REPEATS; ++i)
+            {
+                if (cold)
+                    drop_page_cache(path);
+                start = time_now_ns();
+                if (!mesh_cache_get_earth(&cache, resolution, resolution))
+                    return 1;
+                volatile uint64_t sum = touch_mesh(&cache);
+                (void) sum;
+                uint64_t elapsed = time_now_ns() - start;
+                mesh_cache_close(&cache);
+                if (elapsed < best_load[cold])
+                    best_load[cold] = elapsed;
+            }
+        }
+
+        printf("%-10d %10u %10u %10.3fms %10.3fms %10.3fms %10.3fms\n", resolution, vertex_count, lod_count,
+               ns_to_ms(best_regen), ns_to_ms(build), ns_to_ms(best_load[1]), ns_to_ms(best_load[0]));
+    }
+    return 0;
+}
+
+/* Reference for bench mip: one thread, integer 2x2 average, no SIMD. */
+static uint8_t* naive_box_level(const uint8_t* src, int width, int height, int channels, int* out_width, int* out_height)
+{
+    int w = width / 2 ? width / 2 : 1;
+    int h = height / 2 ? height / 2 : 1;
+    uint8_t* dst = malloc((size_t) w * h * channels);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                int sx0 = 2 * x, sx1 = 2 * x + 1 < width ? 2 * x + 1 : 2 * x;
+                int sy0 = 2 * y, sy1 = 2 * y + 1 < height ? 2 * y + 1 : 2 * y;
+                int sum = src[((size_t) sy0 * width + sx0) * channels + c] + src[((size_t) sy0 * width + sx1) * channels + c]
+                    + src[((size_t) sy1 * width + sx0) * channels + c] + src[((size_t) sy1 * width + sx1) * channels + c];
+                dst[((size_t) y * w + x) * channels + c] = (uint8_t) ((sum + 2) / 4);
+            }
+        }
+    }
+    *out_width = w;
+    *out_height = h;
+    return dst;
+}
+
+/* The SIMD box filter rounds through its own fixed point, so allow off by one. */
+static bool mip_levels_match(const MipChain* chain, const MipLevel* expected, int count)
+{
+    if (chain->level_count != count)
+        return false;
+    for (int i = 1; i < count; ++i)
+    {
+        const MipLevel* level = &chain->levels[i];
+        if (level->width != expected[i].width || level->height != expected[i].height)
+            return false;
+        size_t size = (size_t) level->width * level->height * chain->channels;
+        for (size_t j = 0; j < size; ++j)
+        {
+            if (abs(level->data[j] - expected[i].data[j]) > 1)
+                return false;
+        }
+    }
+    return true;
+}
+
+static int bench_mip(int argc, char** argv)
+{
+    int width = argc > 0 ? atoi(argv[0]) : 8192;
+    int height = argc > 1 ? atoi(argv[1]) : 4096;
+    int channels = argc > 2 ? atoi(argv[2]) : 4;
+    if (width < 1 || height < 1 || channels < 1 || channels > 4)
+        return 1;
+
+    // smooth gradient plus noise so the filters have something to chew on
+    size_t size = (size_t) width * height * channels;
+    uint8_t* image = malloc(size);
+    uint32_t seed = 1;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width * channels; ++x)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            image[(size_t) y * width * channels + x] = (uint8_t) ((x / channels + y) / 64 + (seed >> 28));
+        }
+    }
+    double mpixels = 0.0;
+    for (int w = width, h = height; w > 1 || h > 1; w = w / 2 ? w / 2 : 1, h = h / 2 ? h / 2 : 1)
+        mpixels += (double) (w / 2 ? w / 2 : 1) * (h / 2 ? h / 2 : 1) / 1e6;
+
+    printf("%dx%d, %d channels, %ld cpus, %.1f Mpixels of mips\n", width, height, channels, sysconf(_SC_NPROCESSORS_ONLN), mpixels);
+    printf("%-24s %10s %12s\n", "variant", "time", "Mpixels/s");
+
+    // the naive levels are kept as the expected output of the box filter
+    MipLevel naive[MIP_MAX_LEVELS] = {{image, width, height}};
+    int naive_count = 1;
+    uint64_t start = time_now_ns();
+    while (naive_count < MIP_MAX_LEVELS && (naive[naive_count - 1].width > 1 || naive[naive_count - 1].height > 1))
+    {
+        const MipLevel* level = &naive[naive_count - 1];
+        MipLevel* next = &naive[naive_count++];
+        next->data = naive_box_level(level->data, level->width, level->height, channels, &next->width, &next->height);
+    }
+    double naive_ms = ns_to_ms(time_now_ns() - start);
+    printf("%-24s %8.1fms %12.1f\n", "naive scalar box", naive_ms, mpixels / (naive_ms / 1000.0));
+
+    bool all_match = true;
+    static const MipFilter filters[] = {MIP_FILTER_BOX, MIP_FILTER_KAISER, MIP_FILTER_LANCZOS};
+    for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+    {
+        for (int space = MIP_COLOR_LINEAR; space <= MIP_COLOR_SRGB; ++space)
+        {
+            for (int threads = 1; threads >= 0; --threads)
+            {
+                MipOptions options = {.filter = filters[f], .color_space = space, .thread_count = threads};
+                MipChain chain;
+                start = time_now_ns();
+                if (!mip_chain_build(&chain, image, width, height, channels, &options))
+                    return 1;
+                double ms = ns_to_ms(time_now_ns() - start);
+                // only linear box computes what the naive reference does
+                bool match = filters[f] != MIP_FILTER_BOX || space != MIP_COLOR_LINEAR
+                    || mip_levels_match(&chain, naive, naive_count);
+                all_match &= match;
+                mip_chain_free(&chain);
+
+                char name[64];
+                snprintf(name, sizeof(name), "%s %s %s", mip_filter_name(filters[f]),
+                         space == MIP_COLOR_SRGB ? "srgb" : "linear", threads ? "1 thread" : "all threads");
+                printf("%-24s %8.1fms %12.1f (%.2fx naive)%s\n", name, ms, mpixels / (ms / 1000.0), naive_ms / ms,
+                       match ? "" : " MISMATCH");
+            }
+        }
+    }
+    for (int i = 1; i < naive_count; ++i)
+        free(naive[i].data);
+    free(image);
+    return all_match ? 0 : 1;
+}
+
+/* Reference for bench convert: one texel at a time, formulas instead of LUTs. */
+static void naive_convert(const PixelConversion* conversion, const uint8_t* src, uint8_t* dst, size_t count)
+{
+    int sc = conversion->src_channels, dc = conversion->dst_channels;
+    bool alpha = dc == 2 || dc == 4;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int c = 0; c < dc; ++c)
+        {
+            int v = c < sc ? src[i * sc + c] : 255;
+            if (!(alpha && c == dc - 1))
+            {
+                float f = v / 255.0f;
+                if (conversion->flags & PIXEL_CONVERT_SRGB_TO_LINEAR)
+                    v = (int) ((f <= 0.04045f ? f / 12.92f : powf((f + 0.055f) / 1.055f, 2.4f)) * 255.0f + 0.5f);
+                else if (conversion->flags & PIXEL_CONVERT_LINEAR_TO_SRGB)
+                    v = (int) ((f <= 0.0031308f ? f * 12.92f : 1.055f * powf(f, 1.0f / 2.4f) - 0.055f) * 255.0f + 0.5f);
+            }
+            dst[i * dc + c] = (uint8_t) v;
+        }
+        if (conversion->flags & PIXEL_CONVERT_PREMULTIPLY)
+        {
+            int a = dst[i * dc + dc - 1];
+            for (int c = 0; c < dc - 1; ++c)
+                dst[i * dc + c] = (uint8_t) ((dst[i * dc + c] * a + 127) / 255);
+        }
+    }
+}
+
+static int bench_convert(int argc, char** argv)
+{
+    int width = argc > 0 ? atoi(argv[0]) : 4096;
+    int height = argc > 1 ? atoi(argv[1]) : 4096;
+    if (width < 1 || height < 1)
+        return 1;
+
+    static const struct
+    {
+        const char* name;
+        int channels;
+        unsigned int flags;
+    }cases[] = {
+        {"gray -> r8", 1, 0},
+        {"rgb -> rgba", 3, 0},
+        {"rgb srgb -> linear", 3, PIXEL_CONVERT_SRGB_TO_LINEAR},
+        {"rgba linear -> srgb", 4, PIXEL_CONVERT_LINEAR_TO_SRGB},
+        {"rgba premultiply", 4, PIXEL_CONVERT_PREMULTIPLY},
+        {"gray+a premultiply", 2, PIXEL_CONVERT_PREMULTIPLY},
+        {"rgba srgb->lin+premul", 4, PIXEL_CONVERT_SRGB_TO_LINEAR | PIXEL_CONVERT_PREMULTIPLY},
+    };
+
+    size_t count = (size_t) width * height;
+    uint8_t* src = malloc(count * 4);
+    uint8_t* dst = malloc(count * 4);
+    uint8_t* expected = malloc(count * 4);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < count * 4; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        src[i] = (uint8_t) (seed >> 24);
+    }
+
+    // GB/s counts bytes read plus bytes written
+    printf("%dx%d texels\n", width, height);
+    printf("%-24s %10s %8s %10s %8s %8s\n", "conversion", "naive", "GB/s", "simd", "GB/s", "speedup");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        PixelConversion conversion = pixel_conversion_make(cases[i].channels, cases[i].flags);
+        double bytes = (double) count * (conversion.src_channels + conversion.dst_channels);
+
+        uint64_t start = time_now_ns();
+        naive_convert(&conversion, src, expected, count);
+        double naive_ms = ns_to_ms(time_now_ns() - start);
+
+        // first pass faults dst in so the timed pass measures the kernel
+        pixel_convert(&conversion, src, dst, count);
+        start = time_now_ns();
+        pixel_convert(&conversion, src, dst, count);
+        double ms = ns_to_ms(time_now_ns() - start);
+
+        bool match = memcmp(dst, expected, count * conversion.dst_channels) == 0;
+        printf("%-24s %8.1fms %8.2f %8.1fms %8.2f %7.1fx%s\n", cases[i].name, naive_ms, bytes / (naive_ms * 1e6),
+               ms, bytes / (ms * 1e6), naive_ms / ms, match ? "" : " MISMATCH");
+    }
+
+    // four gray maps into one rgba texture, the fourth plane missing
+    const uint8_t* planes[4] = {src, src + count, src + count * 2, NULL};
+    double bytes = (double) count * (3 + 4);
+    uint64_t start = time_now_ns();
+    for (size_t i = 0; i < count; ++i)
+    {
+        expected[i * 4 + 0] = planes[0][i];
+        expected[i * 4 + 1] = planes[1][i];
+        expected[i * 4 + 2] = planes[2][i];
+        expected[i * 4 + 3] = 0;
+    }
+    double naive_ms = ns_to_ms(time_now_ns() - start);
+    pixel_interleave4(planes, 0, dst, count);
+    start = time_now_ns();
+    pixel_interleave4(planes, 0, dst, count);
+    double ms = ns_to_ms(time_now_ns() - start);
+    bool match = memcmp(dst, expected, count * 4) == 0;
+    printf("%-24s %8.1fms %8.2f %8.1fms %8.2f %7.1fx%s\n", "3 planes -> rgba", naive_ms, bytes / (naive_ms * 1e6),
+           ms, bytes / (ms * 1e6), naive_ms / ms, match ? "" : " MISMATCH");
+    free(src);
+    free(dst);
+    free(expected);
+    return 0;
+}
+
+/* Decodes every default image at once on pools of 1, 2, 4... threads. The
+ * files are mapped and touched first so only decoding is timed. */
+static int bench_decode(int argc, char** argv)
+{
+    int max_threads = argc > 0 ? atoi(argv[0]) : 8;
+    size_t budget = argc > 1 ? (size_t) atoi(argv[1]) << 20 : 0;
+    if (max_threads < 1)
+        return 1;
+
+    FileSpan spans[sizeof(default_assets) / sizeof(default_assets[0])];
+    int count = 0;
+    size_t encoded = 0;
+    for (size_t i = 0; i < sizeof(default_assets) / sizeof(default_assets[0]); ++i)
+    {
+        if (!strstr(default_assets[i], ".jpg"))
+            continue;
+        if (!map_file(default_assets[i], &spans[count], FILE_ACCESS_WILLNEED))
+        {
+            perror(default_assets[i]);
+            continue;
+        }
+        touch_bytes(spans[count].data, spans[count].size);
+        encoded += spans[count].size;
+        count++;
+    }
+
+    printf("%d images, %.1fMB encoded, budget %s\n", count, encoded / 1e6, budget ? argv[1] : "unbounded");
+    printf("%-8s %10s %10s %10s %12s %12s\n", "threads", "batch", "slowest", "sum", "in MB/s", "out MB/s");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        DecodePool pool;
+        if (!decode_pool_init(&pool, threads, budget))
+            return 1;
+        uint64_t start = time_now_ns();
+        for (int i = 0; i < count; ++i)
+            decode_pool_submit_memory(&pool, spans[i].data, spans[i].size, 0, i);
+        DecodeResult result;
+        uint64_t slowest = 0, sum = 0;
+        size_t decoded = 0;
+        while (decode_pool_next(&pool, &result, true))
+        {
+            slowest = result.decode_ns > slowest ? result.decode_ns : slowest;
+            sum += result.decode_ns;
+            decoded += result.decoded_size;
+            // released straight away, so a budget only limits how many decode at once
+            decode_pool_release(&pool, &result);
+        }
+        double batch_ms = ns_to_ms(time_now_ns() - start);
+        decode_pool_shutdown(&pool);
+        printf("%-8d %8.1fms %8.1fms %8.1fms %12.1f %12.1f\n", threads, batch_ms, ns_to_ms(slowest), ns_to_ms(sum),
+               encoded / (batch_ms * 1e3), decoded / (batch_ms * 1e3));
+    }
+    for (int i = 0; i < count; ++i)
+        unmap_file(&spans[i]);
+    return 0;
+}
+
+static int compare_commands(const void* a, const void* b)
+{
+    uint64_t ka = ((const DrawCommand*) a)->key, kb = ((const DrawCommand*) b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static void print_command_stats(const char* name, const CommandStats* stats)
+{
+    uint64_t binds = stats->shader_binds + stats->texture_binds + stats->mesh_binds;
+    printf("%-10s %8lu %8lu %8lu %8lu %10lu %9lu\n", name, (unsigned long) stats->draws,
+           (unsigned long) stats->shader_binds, (unsigned long) stats->texture_binds,
+           (unsigned long) stats->mesh_binds, (unsigned long) binds, (unsigned long) stats->skipped_binds);
+}
+
+static int bench_commands(int argc, char** argv)
+{
+    int count = argc > 0 ? atoi(argv[0]) : 100000;
+    int shaders = argc > 1 ? atoi(argv[1]) : 4;
+    int textures = argc > 2 ? atoi(argv[2]) : 64;
+    int meshes = argc > 3 ? atoi(argv[3]) : 16;
+    if (count < 1 || shaders < 1 || textures < 1 || meshes < 1)
+        return 1;
+
+    // submission order is scene order, which says nothing about state
+    CommandBuffer buffer = {0};
+    uint32_t seed = 1;
+    float model[16] = {0};
+    for (int i = 0; i < count; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t shader = (seed >> 8) % shaders;
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t texture = (seed >> 8) % textures;
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t mesh = (seed >> 8) % meshes;
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t depth = command_depth((seed >> 8) / 16777216.0f * 100.0f, 100.0f);
+        model[3] = (float) i;
+        if (!command_buffer_push(&buffer, command_key(0, shader, texture, mesh, depth), model, sizeof(model)))
+            return 1;
+    }
+    DrawCommand* unsorted = malloc(buffer.count * sizeof(DrawCommand));
+    memcpy(unsorted, buffer.commands, buffer.count * sizeof(DrawCommand));
+
+    // the null backend, every callback is NULL so execution only counts
+    RenderBackend null_backend = {0};
+    printf("%d draws over %d shaders, %d textures, %d meshes\n", count, shaders, textures, meshes);
+    printf("%-10s %8s %8s %8s %8s %10s %9s\n", "order", "draws", "shader", "texture", "mesh", "binds", "skipped");
+    CommandStats stats = {0};
+    command_buffer_execute(&buffer, &null_backend, &stats);
+    print_command_stats("submitted", &stats);
+
+    uint64_t start = time_now_ns();
+    qsort(buffer.commands, buffer.count, sizeof(DrawCommand), compare_commands);
+    double qsort_ms = ns_to_ms(time_now_ns() - start);
+    DrawCommand* expected = malloc(buffer.count * sizeof(DrawCommand));
+    memcpy(expected, buffer.commands, buffer.count * sizeof(DrawCommand));
+
+    memcpy(buffer.commands, unsorted, buffer.count * sizeof(DrawCommand));
+    start = time_now_ns();
+    command_buffer_sort(&buffer);
+    double radix_ms = ns_to_ms(time_now_ns() - start);
+
+    stats = (CommandStats) {0};
+    command_buffer_execute(&buffer, &null_backend, &stats);
+    print_command_stats("sorted", &stats);
+
+    // qsort isn't stable, equal keys may land in any order so compare keys only
+    bool match = true;
+    for (size_t i = 0; i < buffer.count; ++i)
+        match &= buffer.commands[i].key == expected[i].key;
+    printf("sort: qsort %.2fms, radix %.2fms (%.1fx)%s\n", qsort_ms, radix_ms, qsort_ms / radix_ms,
+           match ? "" : " MISMATCH");
+
+    free(unsorted);
+    free(expected);
+    command_buffer_free(&buffer);
+    return match ? 0 : 1;
+}
+
+static const BenchCommand commands[] = {
+    {"io", "[files...]", bench_io},
+    {"mesh", "[sectors...]", bench_mesh},
+    {"mip", "[width height channels]", bench_mip},
+    {"convert", "[width height]", bench_convert},
+    {"decode", "[max_threads [budget_mb]]", bench_decode},
+    {"commands", "[count shaders textures meshes]", bench_commands},
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage:\n");
+    for (size_t i = 0; i < COMMAND_COUNT; ++i)
+        fprintf(stderr, "  %s %s %s\n", prog, commands[i].name, commands[i].usage);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < COMMAND_COUNT; ++i)
+    {
+        if (strcmp(argv[1], commands[i].name) == 0)
+            return commands[i].run(argc - 2, argv + 2);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,293 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "profiler.h"
+
+// one slow turn of the globe with a tilt and a zoom in and back out
+static const CameraKey default_keys[] = {
+    {  0.0f, {0.0f, 0.0f, -1.5f},  0.0f,            0.0f},
+    {150.0f, {0.0f, 0.0f, -1.5f},  (float) M_PI_2,  0.0f},
+    {300.0f, {0.0f, 0.0f, -1.25f}, (float) M_PI,    0.4f},
+    {450.0f, {0.1f, 0.0f, -1.3f},  3 * (float) M_PI_2, -0.3f},
+    {600.0f, {0.0f, 0.0f, -1.5f},  2 * (float) M_PI, 0.0f},
+};
+
+bool camera_path_load(CameraPath* path, const char* file_path)
+{
+    FILE* file = fopen(file_path, "r");
+    if (!file)
+    {
+        perror("Error opening camera path");
+        return false;
+    }
+
+    int capacity = 16;
+    path->keys = malloc(capacity * sizeof(CameraKey));
+    path->count = 0;
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+        char* text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\0')
+            continue;
+
+        CameraKey key;
+        if (sscanf(text, "%f %f %f %f %f %f", &key.frame, &key.position.x, &key.position.y, &key.position.z,
+                   &key.x_rot, &key.y_rot) != 6 || (path->count && key.frame <= path->keys[path->count - 1].frame))
+        {
+            printf("%s:%d: expected 'frame x y z x_rot y_rot' with increasing frames\n", file_path, line_number);
+            fclose(file);
+            camera_path_free(path);
+            return false;
+        }
+        if (path->count == capacity)
+        {
+            capacity *= 2;
+            path->keys = realloc(path->keys, capacity * sizeof(CameraKey));
+        }
+        path->keys[path->count++] = key;
+    }
+    fclose(file);
+    if (path->count == 0)
+    {
+        printf("%s: no camera keys\n", file_path);
+        camera_path_free(path);
+        return false;
+    }
+    return true;
+}
+
+void camera_path_default(CameraPath* path)
+{
+    path->count = sizeof(default_keys) / sizeof(default_keys[0]);
+    path->keys = malloc(sizeof(default_keys));
+    memcpy(path->keys, default_keys, sizeof(default_keys));
+}
+
+void camera_path_sample(const CameraPath* path, float frame, CameraKey* key)
+{
+    const CameraKey* keys = path->keys;
+    if (frame <= keys[0].frame)
+    {
+        *key = keys[0];
+        return;
+    }
+    for (int i = 1; i < path->count; ++i)
+    {
+        if (frame <= keys[i].frame)
+        {
+            float t = (frame - keys[i - 1].frame) / (keys[i].frame - keys[i - 1].frame);
+            *key = (CameraKey) {
+                .frame = frame,
+                .position = {
+                    keys[i - 1].position.x + t * (keys[i].position.x - keys[i - 1].position.x),
+                    keys[i - 1].position.y + t * (keys[i].position.y - keys[i - 1].position.y),
+                    keys[i - 1].position.z + t * (keys[i].position.z - keys[i - 1].position.z),
+                },
+                .x_rot = keys[i - 1].x_rot + t * (keys[i].x_rot - keys[i - 1].x_rot),
+                .y_rot = keys[i - 1].y_rot + t * (keys[i].y_rot - keys[i - 1].y_rot),
+            };
+            return;
+        }
+    }
+    *key = keys[path->count - 1];
+}
+
+int camera_path_length(const CameraPath* path)
+{
+    return (int) path->keys[path->count - 1].frame + 1;
+}
+
+void camera_path_free(CameraPath* path)
+{
+    free(path->keys);
+    path->keys = NULL;
+    path->count = 0;
+}
+
+void benchmark_init(Benchmark* benchmark, int warmup)
+{
+    *benchmark = (Benchmark) {.warmup = warmup};
+}
+
+void benchmark_add_frame(Benchmark* benchmark, uint64_t frame_ns)
+{
+    if (benchmark->frame_count == benchmark->frame_capacity)
+    {
+        benchmark->frame_capacity = benchmark->frame_capacity ? benchmark->frame_capacity * 2 : 1024;
+        benchmark->frame_ms = realloc(benchmark->frame_ms, benchmark->frame_capacity * sizeof(double));
+    }
+    benchmark->frame_ms[benchmark->frame_count++] = frame_ns / 1e6;
+}
+
+void benchmark_add_timing(Benchmark* benchmark, const char* name, uint64_t ns)
+{
+    if (benchmark->timing_count < BENCHMARK_MAX_TIMINGS)
+        benchmark->timings[benchmark->timing_count++] = (BenchmarkTiming) {.name = name, .ms = ns / 1e6};
+}
+
+void benchmark_free(Benchmark* benchmark)
+{
+    free(benchmark->frame_ms);
+    *benchmark = (Benchmark) {0};
+}
+
+typedef struct Distribution
+{
+    int count;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+}Distribution;
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank percentiles, sorts samples in place
+static Distribution distribution(double* samples, int count)
+{
+    Distribution d = {.count = count};
+    if (count == 0)
+        return d;
+    qsort(samples, count, sizeof(double), compare_double);
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i)
+        sum += samples[i];
+    d.mean = sum / count;
+    d.p50 = samples[(int) ceil(0.50 * count) - 1];
+    d.p95 = samples[(int) ceil(0.95 * count) - 1];
+    d.p99 = samples[(int) ceil(0.99 * count) - 1];
+    d.max = samples[count - 1];
+    return d;
+}
+
+typedef struct Stage
+{
+    const char* thread;
+    const char* name;
+    int count;
+    int capacity;
+    double* samples;
+}Stage;
+
+typedef struct StageList
+{
+    int warmup;
+    int count;
+    Stage stages[BENCHMARK_MAX_STAGES];
+}StageList;
+
+static void collect_stage(const char* thread, const ProfilerEvent* event, void* user)
+{
+    StageList* list = user;
+    if ((int) event->frame < list->warmup)
+        return;
+    int s = 0;
+    while (s < list->count && !(list->stages[s].name == event->name && list->stages[s].thread == thread))
+        ++s;
+    if (s == list->count)
+    {
+        if (list->count == BENCHMARK_MAX_STAGES)
+            return;
+        list->stages[list->count++] = (Stage) {.thread = thread, .name = event->name};
+    }
+    Stage* stage = &list->stages[s];
+    if (stage->count == stage->capacity)
+    {
+        stage->capacity = stage->capacity ? stage->capacity * 2 : 256;
+        stage->samples = realloc(stage->samples, stage->capacity * sizeof(double));
+    }
+    stage->samples[stage->count++] = (event->end_ns - event->begin_ns) / 1e6;
+}
+
+static void print_distribution(const char* label, const Distribution* d)
+{
+    printf("%-24s %6d %9.3f %9.3f %9.3f %9.3f %9.3f\n", label, d->count, d->mean, d->p50, d->p95, d->p99, d->max);
+}
+
+static void write_distribution(FILE* file, const Distribution* d)
+{
+    fprintf(file, "{\"count\":%d,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            d->count, d->mean, d->p50, d->p95, d->p99, d->max);
+}
+
+bool benchmark_report(const Benchmark* benchmark, const char* json_path, const char* renderer, int width, int height)
+{
+    int measured = benchmark->frame_count - benchmark->warmup;
+    if (measured <= 0)
+    {
+        printf("benchmark: no frames after %d warmup frames\n", benchmark->warmup);
+        return false;
+    }
+    double* frames = malloc(measured * sizeof(double));
+    memcpy(frames, benchmark->frame_ms + benchmark->warmup, measured * sizeof(double));
+    Distribution frame = distribution(frames, measured);
+    free(frames);
+
+    StageList stages = {.warmup = benchmark->warmup};
+    profiler_for_each_event(collect_stage, &stages);
+    Distribution stage_stats[BENCHMARK_MAX_STAGES];
+    for (int s = 0; s < stages.count; ++s)
+        stage_stats[s] = distribution(stages.stages[s].samples, stages.stages[s].count);
+
+    printf("%-24s %6s %9s %9s %9s %9s %9s\n", "ms", "count", "mean", "p50", "p95", "p99", "max");
+    print_distribution("frame", &frame);
+    for (int s = 0; s < stages.count; ++s)
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "%s/%s", stages.stages[s].thread, stages.stages[s].name);
+        print_distribution(label, &stage_stats[s]);
+    }
+    for (int t = 0; t < benchmark->timing_count; ++t)
+        printf("%-24s %9.3f\n", benchmark->timings[t].name, benchmark->timings[t].ms);
+
+    bool ok = true;
+    if (json_path)
+    {
+        FILE* file = fopen(json_path, "w");
+        if (!file)
+        {
+            perror("Error writing benchmark results");
+            ok = false;
+        }
+        else
+        {
+            fprintf(file, "{\n  \"renderer\": \"");
+            for (const char* c = renderer; *c; ++c)
+                if (*c != '"' && *c != '\\')
+                    fputc(*c, file);
+            fprintf(file, "\",\n  \"width\": %d,\n  \"height\": %d,\n  \"warmup_frames\": %d,\n  \"frame_ms\": ",
+                    width, height, benchmark->warmup);
+            write_distribution(file, &frame);
+            fprintf(file, ",\n  \"stages_ms\": [");
+            for (int s = 0; s < stages.count; ++s)
+            {
+                fprintf(file, "%s\n    {\"thread\":\"%s\",\"name\":\"%s\",\"stats\":", s ? "," : "",
+                        stages.stages[s].thread, stages.stages[s].name);
+                write_distribution(file, &stage_stats[s]);
+                fprintf(file, "}");
+            }
+            fprintf(file, "\n  ],\n  \"timings_ms\": {");
+            for (int t = 0; t < benchmark->timing_count; ++t)
+                fprintf(file, "%s\"%s\":%.4f", t ? "," : "", benchmark->timings[t].name, benchmark->timings[t].ms);
+            fprintf(file, "}\n}\n");
+            ok = fclose(file) == 0;
+            if (ok)
+                printf("wrote benchmark results to %s\n", json_path);
+        }
+    }
+
+    for (int s = 0; s < stages.count; ++s)
+        free(stages.stages[s].samples);
+    return ok;
+}
@@ -0,0 +1,62 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "geom.h"
+
+#define BENCHMARK_WARMUP_FRAMES 10
+#define BENCHMARK_MAX_STAGES 32
+#define BENCHMARK_MAX_TIMINGS 8
+
+/* One point on a camera path. Between keys the pose is interpolated
+ * linearly by frame number, so a run does not depend on how long frames take. */
+typedef struct CameraKey
+{
+    float frame;
+    Vec3 position;
+    float x_rot; // model rotation, same units as the mouse drag
+    float y_rot;
+}CameraKey;
+
+typedef struct CameraPath
+{
+    CameraKey* keys;
+    int count;
+}CameraPath;
+
+/* Text file, one key per line: frame pos_x pos_y pos_z x_rot y_rot. Lines
+ * starting with # are comments, keys must be sorted by frame. */
+bool camera_path_load(CameraPath* path, const char* file_path);
+void camera_path_default(CameraPath* path);
+void camera_path_sample(const CameraPath* path, float frame, CameraKey* key);
+int camera_path_length(const CameraPath* path);
+void camera_path_free(CameraPath* path);
+
+// one off durations such as startup milestones, reported next to the frame times
+typedef struct BenchmarkTiming
+{
+    const char* name;
+    double ms;
+}BenchmarkTiming;
+
+typedef struct Benchmark
+{
+    int warmup;
+    int frame_count;
+    int frame_capacity;
+    double* frame_ms;
+    int timing_count;
+    BenchmarkTiming timings[BENCHMARK_MAX_TIMINGS];
+}Benchmark;
+
+void benchmark_init(Benchmark* benchmark, int warmup);
+void benchmark_add_frame(Benchmark* benchmark, uint64_t frame_ns);
+void benchmark_add_timing(Benchmark* benchmark, const char* name, uint64_t ns);
+/* Prints frame time percentiles plus the per stage CPU/GPU times the
+ * profiler recorded after warmup, and writes the same numbers as JSON. */
+bool benchmark_report(const Benchmark* benchmark, const char* json_path, const char* renderer, int width, int height);
+void benchmark_free(Benchmark* benchmark);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "command_buffer.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+_Static_assert(COMMAND_PASS_SHIFT + COMMAND_PASS_BITS <= 64, "sort key fields overflow 64 bits");
+
+uint64_t command_key(uint32_t pass, uint32_t shader, uint32_t texture, uint32_t mesh, uint32_t depth)
+{
+    return ((uint64_t) (pass & ((1u << COMMAND_PASS_BITS) - 1)) << COMMAND_PASS_SHIFT)
+        | ((uint64_t) (shader & ((1u << COMMAND_SHADER_BITS) - 1)) << COMMAND_SHADER_SHIFT)
+        | ((uint64_t) (texture & ((1u << COMMAND_TEXTURE_BITS) - 1)) << COMMAND_TEXTURE_SHIFT)
+        | ((uint64_t) (mesh & ((1u << COMMAND_MESH_BITS) - 1)) << COMMAND_MESH_SHIFT)
+        | ((uint64_t) (depth & ((1u << COMMAND_DEPTH_BITS) - 1)) << COMMAND_DEPTH_SHIFT);
+}
+
+uint32_t command_depth(float depth, float max_depth)
+{
+    uint32_t max = (1u << COMMAND_DEPTH_BITS) - 1;
+    if (!(depth > 0.0f))
+        return 0;
+    if (depth >= max_depth)
+        return max;
+    return (uint32_t) (depth / max_depth * max);
+}
+
+void command_buffer_reset(CommandBuffer* buffer)
+{
+    buffer->count = 0;
+    buffer->payload_size = 0;
+}
+
+bool command_buffer_push(CommandBuffer* buffer, uint64_t key, const void* payload, uint32_t payload_size)
+{
+    if (buffer->count == buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        DrawCommand* commands = realloc(buffer->commands, capacity * sizeof(DrawCommand));
+        if (!commands)
+            return false;
+        buffer->commands = commands;
+        DrawCommand* scratch = realloc(buffer->scratch, capacity * sizeof(DrawCommand));
+        if (!scratch)
+            return false;
+        buffer->scratch = scratch;
+        buffer->capacity = capacity;
+    }
+    // 16 byte aligned so payloads can be read as floats in place
+    size_t offset = (buffer->payload_size + 15) & ~(size_t) 15;
+    if (offset + payload_size > buffer->payload_capacity)
+    {
+        size_t capacity = buffer->payload_capacity ? buffer->payload_capacity : 4096;
+        while (capacity < offset + payload_size)
+            capacity *= 2;
+        uint8_t* data = realloc(buffer->payload, capacity);
+        if (!data)
+            return false;
+        buffer->payload = data;
+        buffer->payload_capacity = capacity;
+    }
+    memcpy(buffer->payload + offset, payload, payload_size);
+    buffer->payload_size = offset + payload_size;
+    buffer->commands[buffer->count++] = (DrawCommand) {
+        .key = key,
+        .payload_offset = (uint32_t) offset,
+        .payload_size = payload_size,
+    };
+    return true;
+}
+
+/* LSD radix sort, stable, one pass per key byte. A byte that is the same in
+ * every key (unused pass bits, a single shader) costs only its histogram. */
+void command_buffer_sort(CommandBuffer* buffer)
+{
+    size_t count = buffer->count;
+    if (count < 2)
+        return;
+
+    static _Thread_local size_t histograms[RADIX_PASSES][RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t key = buffer->commands[i].key;
+        for (int pass = 0; pass < RADIX_PASSES; ++pass)
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+
+    DrawCommand* src = buffer->commands;
+    DrawCommand* dst = buffer->scratch;
+    for (int pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        size_t* histogram = histograms[pass];
+        int shift = pass * RADIX_BITS;
+        if (histogram[(src[0].key >> shift) & (RADIX_BUCKETS - 1)] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; ++b)
+        {
+            size_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i)
+            dst[histogram[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+
+        DrawCommand* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    // an odd number of passes leaves the result in scratch, swap the roles instead of copying
+    buffer->commands = src;
+    buffer->scratch = dst;
+}
+
+void command_buffer_execute(const CommandBuffer* buffer, const RenderBackend* backend, CommandStats* stats)
+{
+    // nothing is current at the start of a buffer
+    uint32_t pass = UINT32_MAX, shader = UINT32_MAX, texture = UINT32_MAX, mesh = UINT32_MAX;
+    for (size_t i = 0; i < buffer->count; ++i)
+    {
+        const DrawCommand* command = &buffer->commands[i];
+        uint64_t key = command->key;
+
+        uint32_t next = COMMAND_FIELD(key, PASS);
+        if (next != pass)
+        {
+            pass = next;
+            stats->pass_changes++;
+            if (backend->begin_pass)
+                backend->begin_pass(backend->context, pass);
+        }
+        else
+        {
+            stats->skipped_binds++;
+        }
+
+        next = COMMAND_FIELD(key, SHADER);
+        if (next != shader)
+        {
+            shader = next;
+            stats->shader_binds++;
+            if (backend->bind_shader)
+                backend->bind_shader(backend->context, shader);
+        }
+        else
+        {
+            stats->skipped_binds++;
+        }
+
+        next = COMMAND_FIELD(key, TEXTURE);
+        if (next != texture)
+        {
+            texture = next;
+            stats->texture_binds++;
+            if (backend->bind_texture)
+                backend->bind_texture(backend->context, texture);
+        }
+        else
+        {
+            stats->skipped_binds++;
+        }
+
+        next = COMMAND_FIELD(key, MESH);
+        if (next != mesh)
+        {
+            mesh = next;
+            stats->mesh_binds++;
+            if (backend->bind_mesh)
+                backend->bind_mesh(backend->context, mesh);
+        }
+        else
+        {
+            stats->skipped_binds++;
+        }
+
+        stats->draws++;
+        if (backend->draw)
+            backend->draw(backend->context, mesh, buffer->payload + command->payload_offset, command->payload_size);
+    }
+}
+
+void command_buffer_free(CommandBuffer* buffer)
+{
+    free(buffer->commands);
+    free(buffer->scratch);
+    free(buffer->payload);
+    *buffer = (CommandBuffer) {0};
+}
@@ -0,0 +1,79 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sort key layout, most significant first. Sorting on the whole key groups
+ * draws by pass, then shader, texture and mesh, and orders each group front
+ * to back. */
+#define COMMAND_PASS_BITS 4
+#define COMMAND_SHADER_BITS 8
+#define COMMAND_TEXTURE_BITS 16
+#define COMMAND_MESH_BITS 12
+#define COMMAND_DEPTH_BITS 24
+
+#define COMMAND_DEPTH_SHIFT 0
+#define COMMAND_MESH_SHIFT (COMMAND_DEPTH_SHIFT + COMMAND_DEPTH_BITS)
+#define COMMAND_TEXTURE_SHIFT (COMMAND_MESH_SHIFT + COMMAND_MESH_BITS)
+#define COMMAND_SHADER_SHIFT (COMMAND_TEXTURE_SHIFT + COMMAND_TEXTURE_BITS)
+#define COMMAND_PASS_SHIFT (COMMAND_SHADER_SHIFT + COMMAND_SHADER_BITS)
+
+#define COMMAND_FIELD(key, name) \
+    ((uint32_t) (((key) >> COMMAND_##name##_SHIFT) & ((1ull << COMMAND_##name##_BITS) - 1)))
+
+typedef struct DrawCommand
+{
+    uint64_t key;
+    uint32_t payload_offset; // into CommandBuffer.payload
+    uint32_t payload_size;
+}DrawCommand;
+
+typedef struct CommandBuffer
+{
+    DrawCommand* commands;
+    DrawCommand* scratch; // radix sort ping-pong buffer
+    size_t count;
+    size_t capacity;
+
+    uint8_t* payload;
+    size_t payload_size;
+    size_t payload_capacity;
+}CommandBuffer;
+
+/* What execution changed and what it was able to skip. */
+typedef struct CommandStats
+{
+    uint64_t draws;
+    uint64_t pass_changes;
+    uint64_t shader_binds;
+    uint64_t texture_binds;
+    uint64_t mesh_binds;
+    uint64_t skipped_binds; // state that was already current
+}CommandStats;
+
+/* Renderer side of execution. ids are whatever the key fields hold, the
+ * backend maps them onto its own resources. Any callback may be NULL. */
+typedef struct RenderBackend
+{
+    void* context;
+    void (*begin_pass)(void* context, uint32_t pass);
+    void (*bind_shader)(void* context, uint32_t shader);
+    void (*bind_texture)(void* context, uint32_t texture);
+    void (*bind_mesh)(void* context, uint32_t mesh);
+    void (*draw)(void* context, uint32_t mesh, const void* payload, uint32_t payload_size);
+}RenderBackend;
+
+uint64_t command_key(uint32_t pass, uint32_t shader, uint32_t texture, uint32_t mesh, uint32_t depth);
+/* Quantizes a view distance in [0, max_depth] to the key's depth bits. */
+uint32_t command_depth(float depth, float max_depth);
+
+void command_buffer_reset(CommandBuffer* buffer);
+/* Copies payload_size bytes of uniform data next to the command. */
+bool command_buffer_push(CommandBuffer* buffer, uint64_t key, const void* payload, uint32_t payload_size);
+void command_buffer_sort(CommandBuffer* buffer);
+void command_buffer_execute(const CommandBuffer* buffer, const RenderBackend* backend, CommandStats* stats);
+void command_buffer_free(CommandBuffer* buffer);
+
+#endif // COMMAND_BUFFER_H
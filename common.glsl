@@ -0,0 +1,18 @@
+// Permutation constants, shared by both stages. The C side is
+// ShaderPermutation in shader_variant.h, which defines these before this
+// file is seen. The defaults only matter to a compile without them.
+#define TEXTURE_NONE 0
+#define TEXTURE_PLAIN 1
+#define TEXTURE_VIRTUAL 2
+#define TEXTURE_PACKED 3
+#define TEXTURE_CUBE 4
+
+#ifndef MODEL_COUNT
+#define MODEL_COUNT 1
+#endif
+#ifndef USE_COLOR
+#define USE_COLOR 0
+#endif
+#ifndef TEXTURE_FORMAT
+#define TEXTURE_FORMAT TEXTURE_PLAIN
+#endif
@@ -0,0 +1,108 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "assets.h"
+#include "cubemap.h"
+#include "image_write.h"
+#include "texture_pack.h"
+#include "util.h"
+
+/* Offline equirectangular to cubemap conversion. Writes the six faces and
+ * reports how many texels the cube needs next to the source at the same
+ * resolution on the equator. A .pack manifest is read as the tiles of one
+ * full sphere map, laid out on its grid before reprojecting. */
+
+static void usage(const char* prog)
+{
+    printf("usage: %s equirect.jpg|tiles.pack out_%%s.png [--face N] [--samples N] [--threads N]\n", prog);
+    printf("  %%s in the output is replaced by px nx py ny pz nz, .png or .ppm\n");
+    printf("  defaults: face size width/4 of the full sphere (equal equatorial resolution), 2x2 samples, every cpu\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || !strstr(argv[2], "%s"))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    int face_size = 0;
+    CubemapOptions options = {0};
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--face") == 0 && i + 1 < argc)
+        {
+            face_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            options.samples = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            options.thread_count = atoi(argv[++i]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int width, height, channels = 1;
+    uint64_t start = time_now_ns();
+    uint8_t* image = NULL;
+    const char* extension = strrchr(argv[1], '.');
+    if (extension && strcmp(extension, ".pack") == 0)
+    {
+        // the manifest and tiles on disk, not the copies compiled in for prog
+        asset_prefer_disk(true);
+        PackManifest manifest;
+        if (!pack_manifest_load(&manifest, argv[1]) || !(image = texture_pack_mosaic(&manifest, &width, &height)))
+        {
+            printf("failed to load %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else if (!(image = stbi_load(argv[1], &width, &height, &channels, 0)))
+    {
+        printf("failed to load %s: %s\n", argv[1], stbi_failure_reason());
+        return 1;
+    }
+    uint64_t decoded = time_now_ns();
+    if (face_size <= 0)
+        face_size = cubemap_equal_face_size(width);
+
+    Cubemap cube;
+    if (!cubemap_from_equirect(&cube, image, width, height, channels, face_size, &options))
+    {
+        printf("failed to reproject %s\n", argv[1]);
+        return 1;
+    }
+    uint64_t reprojected = time_now_ns();
+    free(image);
+
+    bool ok = true;
+    for (int f = 0; f < CUBEMAP_FACES; ++f)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), argv[2], cubemap_face_name(f));
+        ok = image_write(path, face_size, face_size, channels, cube.faces[f], (size_t) face_size * channels) && ok;
+    }
+    cubemap_free(&cube);
+
+    double equirect_texels = (double) width * height;
+    double cube_texels = (double) CUBEMAP_FACES * face_size * face_size;
+    printf("%dx%d equirect -> 6 x %d^2 faces, decode %.1fms, reproject %.1fms\n", width, height, face_size,
+           (decoded - start) / 1e6, (reprojected - decoded) / 1e6);
+    printf("texels: %.2fM equirect, %.2fM cube (%.1f%% %s)\n", equirect_texels / 1e6, cube_texels / 1e6,
+           100.0 * fabs(1.0 - cube_texels / equirect_texels), cube_texels <= equirect_texels ? "saved" : "more");
+    // the top source row is a ring 0.5 texels from the pole, on the cube it is only a few texels round
+    printf("density: %.2f source texels per cube texel on the equator, %.0f next to the poles\n",
+           width / (4.0 * face_size), width / (4.0 * face_size * sin(M_PI / (2.0 * height))));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "cubemap.h"
+
+#define DEFAULT_SAMPLES 2
+#define MIN_RXZ 1e-6f // distance from the polar axis below which a direction counts as the pole
+
+/* Major, s and t axes of each face, from the GL spec's face selection
+ * table: a face texel at (sc, tc) in [-1, 1] looks along major + sc*s + tc*t. */
+static const float face_axes[CUBEMAP_FACES][3][3] = {
+    {{1, 0, 0}, {0, 0, -1}, {0, -1, 0}},
+    {{-1, 0, 0}, {0, 0, 1}, {0, -1, 0}},
+    {{0, 1, 0}, {1, 0, 0}, {0, 0, 1}},
+    {{0, -1, 0}, {1, 0, 0}, {0, 0, -1}},
+    {{0, 0, 1}, {1, 0, 0}, {0, -1, 0}},
+    {{0, 0, -1}, {-1, 0, 0}, {0, -1, 0}},
+};
+
+static const char* face_names[CUBEMAP_FACES] = {"px", "nx", "py", "ny", "pz", "nz"};
+
+typedef struct Source
+{
+    const uint8_t* pixels;
+    uint32_t* row_sums; // per row width + 1 running sums per channel, for box filters of any width
+    int width;
+    int height;
+    int channels;
+}Source;
+
+typedef struct Work
+{
+    const Source* source;
+    Cubemap* cube;
+    int samples;
+    int tiles_per_face;
+    int job_count;
+    atomic_int next_job;
+}Work;
+
+static int online_cpus(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+}
+
+// sum of texels [first, first + count) of a row, wrapping around in longitude
+static uint32_t row_box(const Source* src, int row, int first, int count, int c)
+{
+    const uint32_t* sums = src->row_sums + (size_t) row * (src->width + 1) * src->channels + c;
+    int w = src->width, ch = src->channels;
+    first %= w;
+    first += first < 0 ? w : 0;
+    int end = first + count;
+    if (end <= w)
+        return sums[end * ch] - sums[first * ch];
+    return sums[w * ch] - sums[first * ch] + sums[(end - w) * ch];
+}
+
+/* One tap at (u, v). footprint is how many source texels along longitude
+ * the tap stands for, up to one that is a plain bilinear fetch. */
+static void sample_tap(const Source* src, float u, float v, float footprint, float* acc)
+{
+    int w = src->width, h = src->height, ch = src->channels;
+    float y = v * h - 0.5f;
+    y = y < 0.0f ? 0.0f : (y > h - 1 ? h - 1 : y);
+    int y0 = (int) y;
+    int y1 = y0 + 1 < h ? y0 + 1 : y0;
+    float fy = y - y0;
+    float x = u * w - 0.5f;
+
+    if (footprint <= 1.0f)
+    {
+        int x0 = (int) floorf(x);
+        float fx = x - x0;
+        x0 = ((x0 % w) + w) % w;
+        int x1 = x0 + 1 < w ? x0 + 1 : 0;
+        const uint8_t* r0 = src->pixels + (size_t) y0 * w * ch;
+        const uint8_t* r1 = src->pixels + (size_t) y1 * w * ch;
+        for (int c = 0; c < ch; ++c)
+        {
+            float top = r0[x0 * ch + c] + (r0[x1 * ch + c] - r0[x0 * ch + c]) * fx;
+            float bottom = r1[x0 * ch + c] + (r1[x1 * ch + c] - r1[x0 * ch + c]) * fx;
+            acc[c] += top + (bottom - top) * fy;
+        }
+        return;
+    }
+
+    int count = (int) (footprint + 0.5f);
+    count = count > w ? w : count;
+    int first = (int) floorf(x + 1.0f - count * 0.5f);
+    float scale = 1.0f / count;
+    for (int c = 0; c < ch; ++c)
+    {
+        float top = row_box(src, y0, first, count, c) * scale;
+        float bottom = row_box(src, y1, first, count, c) * scale;
+        acc[c] += top + (bottom - top) * fy;
+    }
+}
+
+#ifdef __SSE2__
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// atan2 to about 1e-5 radians, a polynomial for atan on [0, 1] plus octant fixups
+static __m128 atan2_ps(__m128 y, __m128 x)
+{
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32((int) 0x80000000));
+    __m128 ax = _mm_andnot_ps(sign, x);
+    __m128 ay = _mm_andnot_ps(sign, y);
+    __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f)));
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 r = _mm_set1_ps(0.0208351f);
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.0851330f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.1801410f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.3302995f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.9998660f));
+    r = _mm_mul_ps(r, a);
+    r = select_ps(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps((float) M_PI_2), r), r);
+    r = select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps((float) M_PI), r), r);
+    return _mm_or_ps(r, _mm_and_ps(y, sign));
+}
+#endif
+
+/* Equirect coordinates and longitude footprint of the directions
+ * major + sc*s + tc*t. The texel's angular size, 2/size/|dir|, divided by
+ * the angle one source texel spans at that latitude, 2pi/width*sin(colat),
+ * reduces to width / (pi * size * rxz). */
+static void directions_to_equirect(const float axes[3][3], const float* sc, float tc, int count, float texel_scale,
+                                   float* u, float* v, float* footprint)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 inv_two_pi = _mm_set1_ps((float) (0.5 / M_PI));
+    const __m128 inv_pi = _mm_set1_ps((float) (1.0 / M_PI));
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 scale = _mm_set1_ps(texel_scale);
+    __m128 vtc = _mm_set1_ps(tc);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vsc = _mm_loadu_ps(sc + i);
+        __m128 d[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            d[k] = _mm_add_ps(_mm_set1_ps(axes[0][k]),
+                              _mm_add_ps(_mm_mul_ps(vsc, _mm_set1_ps(axes[1][k])), _mm_mul_ps(vtc, _mm_set1_ps(axes[2][k]))));
+        }
+        __m128 rxz = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[2], d[2])));
+        _mm_storeu_ps(u + i, _mm_add_ps(_mm_mul_ps(atan2_ps(d[2], d[0]), inv_two_pi), half));
+        _mm_storeu_ps(v + i, _mm_mul_ps(atan2_ps(rxz, d[1]), inv_pi));
+        _mm_storeu_ps(footprint + i, _mm_div_ps(scale, _mm_max_ps(rxz, _mm_set1_ps(MIN_RXZ))));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        float d[3];
+        for (int k = 0; k < 3; ++k)
+            d[k] = axes[0][k] + sc[i] * axes[1][k] + tc * axes[2][k];
+        float rxz = sqrtf(d[0] * d[0] + d[2] * d[2]);
+        u[i] = atan2f(d[2], d[0]) * (float) (0.5 / M_PI) + 0.5f;
+        v[i] = atan2f(rxz, d[1]) * (float) (1.0 / M_PI);
+        footprint[i] = texel_scale / fmaxf(rxz, MIN_RXZ);
+    }
+}
+
+static void fill_rows(const Work* work, int face, int row_begin, int row_end)
+{
+    const Source* src = work->source;
+    Cubemap* cube = work->cube;
+    int size = cube->face_size, ch = src->channels, samples = work->samples;
+    float texel_scale = (float) (src->width / (M_PI * size * samples));
+    float* sc = malloc(sizeof(float) * size * 4);
+    float* u = sc + size;
+    float* v = u + size;
+    float* footprint = v + size;
+    float* acc = calloc((size_t) size * ch, sizeof(float));
+
+    for (int y = row_begin; y < row_end; ++y)
+    {
+        memset(acc, 0, sizeof(float) * size * ch);
+        for (int sy = 0; sy < samples; ++sy)
+        {
+            float tc = (y + (sy + 0.5f) / samples) * 2.0f / size - 1.0f;
+            for (int sx = 0; sx < samples; ++sx)
+            {
+                for (int x = 0; x < size; ++x)
+                    sc[x] = (x + (sx + 0.5f) / samples) * 2.0f / size - 1.0f;
+                directions_to_equirect(face_axes[face], sc, tc, size, texel_scale, u, v, footprint);
+                for (int x = 0; x < size; ++x)
+                    sample_tap(src, u[x], v[x], footprint[x], acc + x * ch);
+            }
+        }
+        uint8_t* dst = cube->faces[face] + (size_t) y * size * ch;
+        float norm = 1.0f / (samples * samples);
+        for (int i = 0; i < size * ch; ++i)
+        {
+            float value = acc[i] * norm + 0.5f;
+            dst[i] = (uint8_t) (value > 255.0f ? 255.0f : value);
+        }
+    }
+    free(acc);
+    free(sc);
+}
+
+static void* run_jobs(void* arg)
+{
+    Work* work = arg;
+    int size = work->cube->face_size;
+    for (int job; (job = atomic_fetch_add(&work->next_job, 1)) < work->job_count;)
+    {
+        int face = job / work->tiles_per_face;
+        int row_begin = (job % work->tiles_per_face) * CUBEMAP_TILE_ROWS;
+        int row_end = row_begin + CUBEMAP_TILE_ROWS < size ? row_begin + CUBEMAP_TILE_ROWS : size;
+        fill_rows(work, face, row_begin, row_end);
+    }
+    return NULL;
+}
+
+bool cubemap_from_equirect(Cubemap* cube, const uint8_t* image, int width, int height, int channels, int face_size,
+                           const CubemapOptions* options)
+{
+    *cube = (Cubemap) {.face_size = face_size, .channels = channels};
+    if (width < 1 || height < 1 || channels < 1 || channels > 4 || face_size < 1)
+        return false;
+
+    Source source = {.pixels = image, .width = width, .height = height, .channels = channels};
+    source.row_sums = malloc(sizeof(uint32_t) * height * (width + 1) * channels);
+    bool ok = source.row_sums != NULL;
+    for (int f = 0; ok && f < CUBEMAP_FACES; ++f)
+        ok = (cube->faces[f] = malloc((size_t) face_size * face_size * channels)) != NULL;
+    if (!ok)
+    {
+        free(source.row_sums);
+        cubemap_free(cube);
+        return false;
+    }
+    for (int y = 0; y < height; ++y)
+    {
+        uint32_t* sums = source.row_sums + (size_t) y * (width + 1) * channels;
+        const uint8_t* row = image + (size_t) y * width * channels;
+        memset(sums, 0, sizeof(uint32_t) * channels);
+        for (int i = 0; i < width * channels; ++i)
+            sums[i + channels] = sums[i] + row[i];
+    }
+
+    Work work = {
+        .source = &source,
+        .cube = cube,
+        .samples = options && options->samples > 0 ? options->samples : DEFAULT_SAMPLES,
+        .tiles_per_face = (face_size + CUBEMAP_TILE_ROWS - 1) / CUBEMAP_TILE_ROWS,
+    };
+    work.job_count = work.tiles_per_face * CUBEMAP_FACES;
+    atomic_init(&work.next_job, 0);
+    int thread_count = options && options->thread_count > 0 ? options->thread_count : online_cpus();
+    thread_count = thread_count < work.job_count ? thread_count : work.job_count;
+
+    pthread_t threads[thread_count];
+    for (int i = 1; i < thread_count; ++i)
+    {
+        // a thread that doesn't start just leaves its jobs to the others
+        if (pthread_create(&threads[i], NULL, run_jobs, &work) != 0)
+            threads[i] = 0;
+    }
+    run_jobs(&work);
+    for (int i = 1; i < thread_count; ++i)
+    {
+        if (threads[i])
+            pthread_join(threads[i], NULL);
+    }
+    free(source.row_sums);
+    return true;
+}
+
+int cubemap_equal_face_size(int width)
+{
+    // four faces go round the equator
+    return width / 4 > 0 ? width / 4 : 1;
+}
+
+const char* cubemap_face_name(int face)
+{
+    return face >= 0 && face < CUBEMAP_FACES ? face_names[face] : "?";
+}
+
+void cubemap_free(Cubemap* cube)
+{
+    for (int f = 0; f < CUBEMAP_FACES; ++f)
+        free(cube->faces[f]);
+    *cube = (Cubemap) {0};
+}
@@ -0,0 +1,40 @@
+#ifndef CUBEMAP_H
+#define CUBEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CUBEMAP_FACES 6
+#define CUBEMAP_TILE_ROWS 32 // rows of one face per job
+
+typedef struct CubemapOptions
+{
+    int samples;      // per axis and texel, 0 picks 2
+    int thread_count; // 0 uses every online cpu
+}CubemapOptions;
+
+/* Faces in GL order (+x, -x, +y, -y, +z, -z), each face_size^2 texels with
+ * row 0 at t = 0, so they go to glTexImage2D as they are. */
+typedef struct Cubemap
+{
+    int face_size;
+    int channels;
+    uint8_t* faces[CUBEMAP_FACES];
+}Cubemap;
+
+/* Reprojects a full sphere equirectangular image, longitude along x with
+ * atan2(z, x) = -pi at the left edge and the north pole (+y) on the top row,
+ * the same orientation make_earth_geom uses. Every texel averages
+ * samples^2 taps and each tap is box filtered along longitude over its
+ * footprint, which grows towards the poles, so the faces don't alias where
+ * the source is oversampled. A map split into tiles, like the earth
+ * quadrants, goes through texture_pack_mosaic first. */
+bool cubemap_from_equirect(Cubemap* cube, const uint8_t* image, int width, int height, int channels, int face_size,
+                           const CubemapOptions* options);
+/* Face size that keeps the source's texel density on the equator, width
+ * being that of the full sphere. */
+int cubemap_equal_face_size(int width);
+const char* cubemap_face_name(int face);
+void cubemap_free(Cubemap* cube);
+
+#endif // CUBEMAP_H
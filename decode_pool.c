@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stb_image.h"
+#include "decode_pool.h"
+#include "util.h"
+
+static int online_cpus(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+}
+
+// caller holds the lock
+static bool fits_budget(const DecodePool* pool, size_t size)
+{
+    return pool->memory_budget == 0 || pool->memory_in_use == 0 || pool->memory_in_use + size <= pool->memory_budget;
+}
+
+static void decode(DecodePool* pool, const DecodeRequest* request, DecodeResult* result)
+{
+    FileSpan file = {0};
+    const stbi_uc* data = request->data;
+    int size = (int) request->size;
+    if (request->path[0])
+    {
+        if (!map_file(request->path, &file, FILE_ACCESS_SEQUENTIAL))
+        {
+            perror(request->path);
+            return;
+        }
+        data = (const stbi_uc*) file.data;
+        size = (int) file.size;
+    }
+    result->encoded_size = (size_t) size;
+
+    // reserve the output before decoding so the budget holds for everything in flight
+    int width, height, channels;
+    bool cancelled = false;
+    if (stbi_info_from_memory(data, size, &width, &height, &channels))
+    {
+        size_t decoded = (size_t) width * height * (request->channels ? request->channels : channels);
+        pthread_mutex_lock(&pool->lock);
+        // shutdown ends the wait, the memory it needs may be held by results nobody will collect
+        while (pool->running && !fits_budget(pool, decoded))
+            pthread_cond_wait(&pool->memory, &pool->lock);
+        cancelled = !pool->running;
+        if (!cancelled)
+            pool->memory_in_use += decoded;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (!cancelled)
+        {
+            result->decoded_size = decoded;
+            uint64_t start = time_now_ns();
+            result->pixels = stbi_load_from_memory(data, size, &result->width, &result->height, &channels, request->channels);
+            result->decode_ns = time_now_ns() - start;
+            result->channels = request->channels ? request->channels : channels;
+            result->ok = result->pixels != NULL;
+        }
+    }
+    if (!result->ok && !cancelled)
+        printf("Failed to decode %s: %s\n", request->path[0] ? request->path : "image in memory", stbi_failure_reason());
+    if (file.data)
+        unmap_file(&file);
+}
+
+static void* worker(void* arg)
+{
+    DecodePool* pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (true)
+    {
+        if (pool->pending_count == 0)
+        {
+            if (!pool->running)
+                break;
+            pthread_cond_wait(&pool->work, &pool->lock);
+            continue;
+        }
+        DecodeRequest request = pool->pending[pool->pending_first];
+        pool->pending_first = (pool->pending_first + 1) % DECODE_POOL_MAX_REQUESTS;
+        pool->pending_count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        DecodeResult result = {.tag = request.tag};
+        decode(pool, &request, &result);
+
+        pthread_mutex_lock(&pool->lock);
+        if (!result.ok && result.decoded_size)
+        {
+            pool->memory_in_use -= result.decoded_size;
+            result.decoded_size = 0;
+            pthread_cond_broadcast(&pool->memory);
+        }
+        pool->done[(pool->done_first + pool->done_count) % DECODE_POOL_MAX_REQUESTS] = result;
+        pool->done_count++;
+        pthread_cond_broadcast(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+bool decode_pool_init(DecodePool* pool, int thread_count, size_t memory_budget)
+{
+    *pool = (DecodePool) {.memory_budget = memory_budget, .running = true};
+    thread_count = thread_count > 0 ? thread_count : online_cpus();
+    thread_count = thread_count < DECODE_POOL_MAX_THREADS ? thread_count : DECODE_POOL_MAX_THREADS;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->memory, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    for (int i = 0; i < thread_count; ++i)
+    {
+        if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0)
+            break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0)
+    {
+        perror("Error starting decode threads");
+        decode_pool_shutdown(pool);
+        return false;
+    }
+    return true;
+}
+
+static bool submit(DecodePool* pool, const DecodeRequest* request)
+{
+    pthread_mutex_lock(&pool->lock);
+    bool ok = pool->in_flight < DECODE_POOL_MAX_REQUESTS;
+    if (ok)
+    {
+        pool->pending[(pool->pending_first + pool->pending_count) % DECODE_POOL_MAX_REQUESTS] = *request;
+        pool->pending_count++;
+        pool->in_flight++;
+        pthread_cond_signal(&pool->work);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ok;
+}
+
+bool decode_pool_submit_file(DecodePool* pool, const char* path, int channels, int tag)
+{
+    DecodeRequest request = {.channels = channels, .tag = tag};
+    snprintf(request.path, sizeof(request.path), "%s", path);
+    return submit(pool, &request);
+}
+
+bool decode_pool_submit_memory(DecodePool* pool, const void* data, size_t size, int channels, int tag)
+{
+    DecodeRequest request = {.data = data, .size = size, .channels = channels, .tag = tag};
+    return submit(pool, &request);
+}
+
+bool decode_pool_next(DecodePool* pool, DecodeResult* result, bool wait)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (wait && pool->done_count == 0 && pool->in_flight > 0)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    bool ok = pool->done_count > 0;
+    if (ok)
+    {
+        *result = pool->done[pool->done_first];
+        pool->done_first = (pool->done_first + 1) % DECODE_POOL_MAX_REQUESTS;
+        pool->done_count--;
+        pool->in_flight--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ok;
+}
+
+void decode_pool_release(DecodePool* pool, DecodeResult* result)
+{
+    stbi_image_free(result->pixels);
+    result->pixels = NULL;
+    pthread_mutex_lock(&pool->lock);
+    pool->memory_in_use -= result->decoded_size;
+    pthread_cond_broadcast(&pool->memory);
+    pthread_mutex_unlock(&pool->lock);
+    result->decoded_size = 0;
+}
+
+void decode_pool_shutdown(DecodePool* pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    // whatever has not started is dropped, as are decodes still waiting for
+    // budget; running decodes finish
+    pool->pending_count = 0;
+    pool->running = false;
+    pthread_cond_broadcast(&pool->work);
+    pthread_cond_broadcast(&pool->memory);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->thread_count; ++i)
+        pthread_join(pool->threads[i], NULL);
+
+    for (int i = 0; i < pool->done_count; ++i)
+        stbi_image_free(pool->done[(pool->done_first + i) % DECODE_POOL_MAX_REQUESTS].pixels);
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->memory);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    *pool = (DecodePool) {0};
+}
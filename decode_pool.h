@@ -0,0 +1,75 @@
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DECODE_POOL_MAX_THREADS 16
+#define DECODE_POOL_MAX_REQUESTS 64 // submitted and not yet collected
+#define DECODE_POOL_PATH_MAX 256
+
+typedef struct DecodeRequest
+{
+    char path[DECODE_POOL_PATH_MAX]; // empty for memory requests
+    const void* data;                // caller's encoded bytes, valid until the result is collected
+    size_t size;
+    int channels;                    // forced channel count, 0 keeps the image's own
+    int tag;
+}DecodeRequest;
+
+typedef struct DecodeResult
+{
+    int tag;
+    bool ok;
+    uint8_t* pixels; // stbi allocation, give it back with decode_pool_release
+    int width;
+    int height;
+    int channels;        // of pixels
+    size_t encoded_size;
+    size_t decoded_size; // what counts against the budget
+    uint64_t decode_ns;
+}DecodeResult;
+
+/* Decodes images on a fixed set of threads. Requests are started in
+ * submission order, results come back in completion order. A decode only
+ * starts once its output fits into the memory budget next to every result
+ * that was not released yet, the size comes from the image header, so a
+ * big batch can't blow up memory. A single image larger than the whole
+ * budget still decodes, alone. Collected results count until released, so
+ * a caller that holds a whole batch needs a budget that covers it. */
+typedef struct DecodePool
+{
+    pthread_t threads[DECODE_POOL_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work;     // pending requests
+    pthread_cond_t memory;   // budget freed, apart from work so a submit can't wake a decode waiting on it
+    pthread_cond_t finished; // a result is ready
+    bool running;
+
+    size_t memory_budget;
+    size_t memory_in_use;
+
+    DecodeRequest pending[DECODE_POOL_MAX_REQUESTS]; // ring, oldest first
+    int pending_first;
+    int pending_count;
+    DecodeResult done[DECODE_POOL_MAX_REQUESTS]; // ring in completion order
+    int done_first;
+    int done_count;
+    int in_flight; // submitted but not collected
+}DecodePool;
+
+/* thread_count 0 uses every online cpu, memory_budget 0 is unbounded. */
+bool decode_pool_init(DecodePool* pool, int thread_count, size_t memory_budget);
+bool decode_pool_submit_file(DecodePool* pool, const char* path, int channels, int tag);
+bool decode_pool_submit_memory(DecodePool* pool, const void* data, size_t size, int channels, int tag);
+/* Next finished decode. Blocks when wait is set, returns false once nothing
+ * is outstanding (or, without wait, nothing is finished yet). */
+bool decode_pool_next(DecodePool* pool, DecodeResult* result, bool wait);
+/* Frees the pixels and returns their size to the budget. */
+void decode_pool_release(DecodePool* pool, DecodeResult* result);
+void decode_pool_shutdown(DecodePool* pool);
+
+#endif // DECODE_POOL_H
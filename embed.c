@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Build step that turns files into a C source of const arrays, so they end
+ * up in the executable's read-only data, plus the table assets.c looks
+ * names up in. Run by the makefile with EMBED_ASSETS. */
+
+static void usage(const char* prog)
+{
+    printf("usage: %s out.c [file ...]\n", prog);
+    printf("  each file is embedded under the path it was given as\n");
+}
+
+static void write_name(FILE* out, const char* name)
+{
+    fputc('"', out);
+    for (const char* c = name; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    FILE* out = fopen(argv[1], "w");
+    if (!out)
+    {
+        perror("Error creating embedded asset source");
+        return 1;
+    }
+
+    fprintf(out, "/* Generated by embed, do not edit. */\n#include \"assets.h\"\n\n");
+    long* sizes = calloc(argc, sizeof(long));
+    size_t total = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        FILE* in = sizes ? fopen(argv[i], "rb") : NULL;
+        if (!in)
+        {
+            perror(argv[i]);
+            free(sizes);
+            fclose(out);
+            remove(argv[1]);
+            return 1;
+        }
+        fprintf(out, "static const unsigned char asset_%d[] = {", i - 2);
+        int c;
+        long size = 0;
+        while ((c = fgetc(in)) != EOF)
+        {
+            fprintf(out, "%s0x%02x,", size % 16 ? "" : "\n    ", c);
+            size++;
+        }
+        // terminated so text assets can be used as strings
+        fprintf(out, "\n    0x00,\n};\n\n");
+        fclose(in);
+        sizes[i] = size;
+        total += size;
+    }
+
+    fprintf(out, "const EmbeddedAsset embedded_assets[] = {\n");
+    for (int i = 2; i < argc; ++i)
+    {
+        fprintf(out, "    {");
+        write_name(out, argv[i]);
+        fprintf(out, ", asset_%d, %ld},\n", i - 2, sizes[i]);
+    }
+    fprintf(out, "    {0},\n};\nconst int embedded_asset_count = %d;\n", argc - 2);
+    free(sizes);
+
+    if (fclose(out) != 0)
+    {
+        perror("Error writing embedded asset source");
+        remove(argv[1]);
+        return 1;
+    }
+    printf("embedded %d assets, %zu bytes\n", argc - 2, total);
+    return 0;
+}
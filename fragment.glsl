@@ -1,9 +1,30 @@
 #version 330 core
+#include "common.glsl"
 out vec4 FragColor;
 in vec2 TexCoord;
-in vec3 Color;    
-uniform sampler2D texture1;
+#if USE_COLOR
+in vec3 Color;
+#endif
+#if TEXTURE_FORMAT == TEXTURE_CUBE
+in vec3 Direction;
+#endif
+#include "texture_sampling.glsl"
+
 void main()
 {
-    FragColor = texture(texture1, TexCoord);
+#if TEXTURE_FORMAT == TEXTURE_VIRTUAL
+    vec4 color = sample_virtual(TexCoord);
+#elif TEXTURE_FORMAT == TEXTURE_PACKED
+    vec4 color = sample_packed(TexCoord);
+#elif TEXTURE_FORMAT == TEXTURE_CUBE
+    vec4 color = texture(cube_map, Direction);
+#elif TEXTURE_FORMAT == TEXTURE_PLAIN
+    vec4 color = texture(texture1, TexCoord);
+#else
+    vec4 color = vec4(1.0);
+#endif
+#if USE_COLOR
+    color *= vec4(Color, 1.0);
+#endif
+    FragColor = color;
 }
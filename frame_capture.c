@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glad/glad.h"
+#include "frame_capture.h"
+#include "image_write.h"
+#include "profiler.h"
+#include "util.h"
+
+static void* writer_thread(void* arg)
+{
+    FrameCapture* capture = arg;
+    profiler_set_thread_name("capture writer");
+    pthread_mutex_lock(&capture->lock);
+    while (true)
+    {
+        // oldest first so files appear in frame order
+        CaptureSlot* slot = NULL;
+        for (int i = 0; i < FRAME_CAPTURE_SLOTS; ++i)
+        {
+            CaptureSlot* s = &capture->slots[i];
+            if (s->encoding && (!slot || s->sequence < slot->sequence))
+                slot = s;
+        }
+        if (!slot)
+        {
+            if (!capture->running)
+                break;
+            pthread_cond_wait(&capture->changed, &capture->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&capture->lock);
+
+        uint64_t start = time_now_ns();
+        profiler_begin("encode capture");
+        bool ok = image_write(slot->path, capture->width, capture->height, 3, slot->rows, (size_t) capture->width * 3);
+        profiler_end();
+
+        pthread_mutex_lock(&capture->lock);
+        if (ok)
+            capture->stats.written++;
+        else
+            capture->stats.failed++;
+        capture->stats.write_ns += time_now_ns() - start;
+        slot->encoding = false;
+        pthread_cond_broadcast(&capture->changed);
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+bool frame_capture_init(FrameCapture* capture, int width, int height)
+{
+    *capture = (FrameCapture) {.width = width, .height = height};
+    size_t size = (size_t) width * height * 4;
+    for (int i = 0; i < FRAME_CAPTURE_SLOTS; ++i)
+    {
+        CaptureSlot* slot = &capture->slots[i];
+        slot->rows = malloc((size_t) width * height * 3);
+        if (!slot->rows)
+        {
+            for (int j = 0; j < i; ++j)
+                free(capture->slots[j].rows);
+            return false;
+        }
+        glGenBuffers(1, &slot->pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->changed, NULL);
+    capture->running = true;
+    if (pthread_create(&capture->writer, NULL, writer_thread, capture) != 0)
+    {
+        perror("Error starting capture writer");
+        capture->running = false;
+        frame_capture_shutdown(capture);
+        return false;
+    }
+    return true;
+}
+
+/* Copies a finished readback out of its pbo and hands it to the writer. The
+ * slot's rows are free, the caller made sure of that before the request. */
+static void stage_slot(FrameCapture* capture, CaptureSlot* slot)
+{
+    glDeleteSync(slot->fence);
+    slot->fence = NULL;
+
+    size_t size = (size_t) capture->width * capture->height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    const uint8_t* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) size, GL_MAP_READ_BIT);
+    bool ok = pixels != NULL;
+    if (ok)
+    {
+        // GL rows start at the bottom, images at the top, and alpha is dropped
+        for (int y = 0; y < capture->height; ++y)
+        {
+            const uint8_t* src = pixels + (size_t) (capture->height - 1 - y) * capture->width * 4;
+            uint8_t* dst = slot->rows + (size_t) y * capture->width * 3;
+            for (int x = 0; x < capture->width; ++x)
+            {
+                dst[x * 3 + 0] = src[x * 4 + 0];
+                dst[x * 3 + 1] = src[x * 4 + 1];
+                dst[x * 3 + 2] = src[x * 4 + 2];
+            }
+        }
+        ok = glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_lock(&capture->lock);
+    if (ok)
+        slot->encoding = true;
+    else
+        capture->stats.failed++;
+    pthread_cond_broadcast(&capture->changed);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+void frame_capture_request(FrameCapture* capture, const char* path)
+{
+    CaptureSlot* slot = &capture->slots[capture->next];
+    uint64_t start = time_now_ns();
+    bool stalled = false;
+    if (slot->fence)
+    {
+        // every slot is in flight, the oldest has had the longest to finish
+        glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        stage_slot(capture, slot);
+        stalled = true;
+    }
+    pthread_mutex_lock(&capture->lock);
+    while (slot->encoding)
+    {
+        stalled = true;
+        pthread_cond_wait(&capture->changed, &capture->lock);
+    }
+    if (stalled)
+    {
+        capture->stats.stalls++;
+        capture->stats.stall_ns += time_now_ns() - start;
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    snprintf(slot->path, sizeof(slot->path), "%s", path);
+    slot->sequence = capture->sequence++;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture->next = (capture->next + 1) % FRAME_CAPTURE_SLOTS;
+}
+
+void frame_capture_poll(FrameCapture* capture, bool wait)
+{
+    for (int i = 0; i < FRAME_CAPTURE_SLOTS; ++i)
+    {
+        CaptureSlot* slot = &capture->slots[(capture->next + i) % FRAME_CAPTURE_SLOTS];
+        if (!slot->fence)
+            continue;
+        GLenum status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return;
+        stage_slot(capture, slot);
+    }
+}
+
+void frame_capture_shutdown(FrameCapture* capture)
+{
+    if (capture->running)
+    {
+        frame_capture_poll(capture, true);
+        // the writer drains whatever is still encoding before it exits
+        pthread_mutex_lock(&capture->lock);
+        capture->running = false;
+        pthread_cond_broadcast(&capture->changed);
+        pthread_mutex_unlock(&capture->lock);
+        pthread_join(capture->writer, NULL);
+    }
+    for (int i = 0; i < FRAME_CAPTURE_SLOTS; ++i)
+    {
+        glDeleteBuffers(1, &capture->slots[i].pbo);
+        free(capture->slots[i].rows);
+    }
+    pthread_cond_destroy(&capture->changed);
+    pthread_mutex_destroy(&capture->lock);
+    if (capture->stats.written || capture->stats.failed)
+    {
+        printf("capture: %u frames written, %u failed, %u stalls (%.1fms), %.1fms encoding on the writer\n",
+               capture->stats.written, capture->stats.failed, capture->stats.stalls,
+               capture->stats.stall_ns / 1e6, capture->stats.write_ns / 1e6);
+    }
+    *capture = (FrameCapture) {0};
+}
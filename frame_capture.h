@@ -0,0 +1,57 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_CAPTURE_SLOTS 3 // readbacks in flight before a request has to wait
+#define FRAME_CAPTURE_PATH_MAX 4096
+
+typedef struct CaptureSlot
+{
+    unsigned int pbo;
+    void* fence;   // GLsync while the copy into pbo is in flight
+    bool encoding; // rows belong to the writer thread
+    uint32_t sequence;
+    uint8_t* rows; // flipped RGB copy of the pbo for the writer
+    char path[FRAME_CAPTURE_PATH_MAX];
+}CaptureSlot;
+
+typedef struct CaptureStats
+{
+    uint32_t written;
+    uint32_t failed;
+    uint32_t stalls; // requests that found every slot busy
+    uint64_t stall_ns;
+    uint64_t write_ns;
+}CaptureStats;
+
+/* Reads the framebuffer back through a ring of pixel pack buffers. A request
+ * only queues the copy and a fence, the pixels are mapped a few frames later
+ * once the GPU is done, so capturing never stalls the pipe the way a
+ * glReadPixels into client memory does. Encoding and file IO happen on a
+ * writer thread. */
+typedef struct FrameCapture
+{
+    int width;
+    int height;
+    CaptureSlot slots[FRAME_CAPTURE_SLOTS];
+    int next; // oldest slot, requests fill in order
+    uint32_t sequence;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    CaptureStats stats;
+}FrameCapture;
+
+bool frame_capture_init(FrameCapture* capture, int width, int height);
+/* Queues a readback of the bound read framebuffer to path (.png or .ppm). */
+void frame_capture_request(FrameCapture* capture, const char* path);
+/* Writes out finished readbacks, waiting for all of them when wait is set. */
+void frame_capture_poll(FrameCapture* capture, bool wait);
+void frame_capture_shutdown(FrameCapture* capture);
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "frame_scheduler.h"
+#include "util.h"
+
+void frame_scheduler_init(FrameScheduler* scheduler, double target_fps, int swap_interval, int refresh_rate, bool late_input)
+{
+    *scheduler = (FrameScheduler) {
+        .vsync = swap_interval > 0,
+        .late_input = late_input,
+        .spin_ns = FRAME_SCHEDULER_MAX_SPIN_NS,
+    };
+    if (scheduler->vsync && refresh_rate > 0)
+        scheduler->period_ns = (uint64_t) (1e9 * swap_interval / refresh_rate);
+    else if (target_fps > 0.0)
+        scheduler->period_ns = (uint64_t) (1e9 / target_fps);
+    // without a known refresh rate vsync still paces, we just cannot plan around it
+    if (scheduler->vsync && !scheduler->period_ns)
+        scheduler->late_input = false;
+}
+
+/* Sleeps until spin_ns before the deadline and spins the rest. How late the
+ * sleep returns feeds back into spin_ns so the spin stays short. */
+static void wait_until(FrameScheduler* scheduler, uint64_t deadline_ns)
+{
+    uint64_t now = time_now_ns();
+    if (now >= deadline_ns)
+        return;
+    if (deadline_ns - now > scheduler->spin_ns)
+    {
+        uint64_t wake = deadline_ns - scheduler->spin_ns;
+        struct timespec ts = {.tv_sec = wake / 1000000000ull, .tv_nsec = wake % 1000000000ull};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        now = time_now_ns();
+        uint64_t late = now > wake ? now - wake : 0;
+        // grow straight to the observed lateness plus half again, shrink slowly
+        uint64_t wanted = late + late / 2;
+        if (wanted > scheduler->spin_ns)
+            scheduler->spin_ns = wanted;
+        else
+            scheduler->spin_ns -= (scheduler->spin_ns - wanted) / 16;
+        if (scheduler->spin_ns < FRAME_SCHEDULER_MIN_SPIN_NS)
+            scheduler->spin_ns = FRAME_SCHEDULER_MIN_SPIN_NS;
+        if (scheduler->spin_ns > FRAME_SCHEDULER_MAX_SPIN_NS)
+            scheduler->spin_ns = FRAME_SCHEDULER_MAX_SPIN_NS;
+    }
+
+    uint64_t spin_start = now;
+    while (now < deadline_ns)
+        now = time_now_ns();
+    scheduler->stats.spin_sum_ms += (now - spin_start) / 1e6;
+    scheduler->stats.oversleep_sum_ms += (now - deadline_ns) / 1e6;
+}
+
+void frame_scheduler_wait(FrameScheduler* scheduler)
+{
+    uint64_t now = time_now_ns();
+    if (!scheduler->last_present_ns || !scheduler->period_ns)
+    {
+        scheduler->wake_ns = now;
+        return;
+    }
+
+    // a frame that ran more than a period over resyncs instead of rushing to catch up
+    if (scheduler->next_present_ns + scheduler->period_ns < now)
+        scheduler->next_present_ns = now;
+
+    uint64_t wake = 0;
+    if (scheduler->late_input)
+    {
+        uint64_t lead = scheduler->render_estimate_ns + FRAME_SCHEDULER_LATE_MARGIN_NS;
+        wake = scheduler->next_present_ns > lead ? scheduler->next_present_ns - lead : 0;
+    }
+    else if (!scheduler->vsync)
+    {
+        wake = scheduler->next_present_ns;
+    }
+    wait_until(scheduler, wake);
+    scheduler->wake_ns = time_now_ns();
+}
+
+void frame_scheduler_submitted(FrameScheduler* scheduler)
+{
+    uint64_t render_ns = time_now_ns() - scheduler->wake_ns;
+    if (render_ns > scheduler->render_estimate_ns)
+        scheduler->render_estimate_ns = render_ns;
+    else
+        scheduler->render_estimate_ns -= (scheduler->render_estimate_ns - render_ns) / 32;
+}
+
+void frame_scheduler_presented(FrameScheduler* scheduler)
+{
+    uint64_t now = time_now_ns();
+    FrameSchedulerStats* stats = &scheduler->stats;
+    if (scheduler->last_present_ns)
+    {
+        double interval = (now - scheduler->last_present_ns) / 1e6;
+        stats->frames++;
+        stats->interval_sum_ms += interval;
+        stats->interval_sq_sum_ms += interval * interval;
+        if (scheduler->period_ns)
+        {
+            double period = scheduler->period_ns / 1e6;
+            double error = fabs(interval - period);
+            if (error > stats->max_error_ms)
+                stats->max_error_ms = error;
+            if (interval > 1.5 * period)
+                stats->missed++;
+        }
+    }
+    scheduler->last_present_ns = now;
+    // with vsync the present just happened on a vblank, the next one is a period out
+    if (scheduler->vsync || !scheduler->next_present_ns)
+        scheduler->next_present_ns = now + scheduler->period_ns;
+    else
+        scheduler->next_present_ns += scheduler->period_ns;
+}
+
+void frame_scheduler_print_stats(const FrameScheduler* scheduler)
+{
+    const FrameSchedulerStats* stats = &scheduler->stats;
+    if (!stats->frames)
+        return;
+    double mean = stats->interval_sum_ms / stats->frames;
+    double variance = stats->interval_sq_sum_ms / stats->frames - mean * mean;
+    printf("frame pacing: target %.3fms%s%s, %lu frames\n", scheduler->period_ns / 1e6,
+           scheduler->vsync ? " vsync" : "", scheduler->late_input ? " late input" : "", (unsigned long) stats->frames);
+    printf("  interval mean %.3fms, jitter (stddev) %.3fms, worst error %.3fms, missed %lu\n",
+           mean, sqrt(variance > 0.0 ? variance : 0.0), stats->max_error_ms, (unsigned long) stats->missed);
+    printf("  wake overshoot mean %.3fms, spin mean %.3fms, render estimate %.3fms\n",
+           stats->oversleep_sum_ms / stats->frames, stats->spin_sum_ms / stats->frames, scheduler->render_estimate_ns / 1e6);
+}
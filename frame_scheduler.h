@@ -0,0 +1,60 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_SCHEDULER_MIN_SPIN_NS 200000ull  // never trust the kernel to wake closer than this
+#define FRAME_SCHEDULER_MAX_SPIN_NS 2000000ull
+#define FRAME_SCHEDULER_LATE_MARGIN_NS 500000ull // slack left after the render estimate
+
+typedef struct FrameSchedulerStats
+{
+    uint64_t frames;
+    double interval_sum_ms;
+    double interval_sq_sum_ms;
+    double max_error_ms;     // worst |present interval - period|
+    uint64_t missed;         // presents more than half a period late
+    double oversleep_sum_ms; // how far past the deadline the waits returned
+    double spin_sum_ms;
+}FrameSchedulerStats;
+
+/* Paces frames against present deadlines on CLOCK_MONOTONIC.
+ *
+ * Without vsync the scheduler owns pacing: it sleeps until shortly before the
+ * deadline and spins the rest of the way, the spin margin follows how late
+ * the kernel actually wakes us. With vsync the swap blocks so the scheduler
+ * never adds a wait of its own unless late input sampling is on.
+ *
+ * With late_input the wait ends a render estimate before the next present
+ * instead of right after the previous one, so input is sampled as late as
+ * the frame allows. The estimate jumps up to any slower frame and decays
+ * slowly, trading a little latency for not missing deadlines. */
+typedef struct FrameScheduler
+{
+    uint64_t period_ns; // 0 renders as fast as possible
+    bool vsync;
+    bool late_input;
+
+    uint64_t next_present_ns;
+    uint64_t last_present_ns;
+    uint64_t wake_ns;
+    uint64_t spin_ns;
+    uint64_t render_estimate_ns;
+
+    FrameSchedulerStats stats;
+}FrameScheduler;
+
+/* target_fps 0 means unlimited. With swap_interval > 0 and a known refresh
+ * rate the period follows the display instead of target_fps. */
+void frame_scheduler_init(FrameScheduler* scheduler, double target_fps, int swap_interval, int refresh_rate, bool late_input);
+/* Call before sampling input. */
+void frame_scheduler_wait(FrameScheduler* scheduler);
+/* Call right before the swap. The render estimate stops here, a vsync swap
+ * blocks until the vblank and would count the wait as rendering. */
+void frame_scheduler_submitted(FrameScheduler* scheduler);
+/* Call right after the swap returns. */
+void frame_scheduler_presented(FrameScheduler* scheduler);
+void frame_scheduler_print_stats(const FrameScheduler* scheduler);
+
+#endif // FRAME_SCHEDULER_H
@@ -24,9 +24,18 @@ Vec3 vec3_normalize(Vec3 v)
     };
 }
 
+static void* grow(void* buffer, size_t* capacity, size_t elem_size)
+{
+    *capacity = *capacity ? *capacity * 2 : INITIAL_CAPACITY;
+    buffer = realloc(buffer, *capacity * elem_size);
+    assert(buffer);
+    return buffer;
+}
+
 void push_back_vb(struct Vertex_Buffer* buff, Vertex vertex)
 {
-    assert(buff->size < CAPACITY);
+    if (buff->size == buff->capacity)
+        buff->buffer = grow(buff->buffer, &buff->capacity, sizeof(Vertex));
 
     buff->buffer[buff->size] = vertex;
     buff->size++;
@@ -34,7 +43,8 @@ void push_back_vb(struct Vertex_Buffer* buff, Vertex vertex)
 
 void push_back_fb(struct Float_Buffer* buff, float f)
 {
-    assert(buff->size < CAPACITY);
+    if (buff->size == buff->capacity)
+        buff->buffer = grow(buff->buffer, &buff->capacity, sizeof(float));
 
     buff->buffer[buff->size] = f;
     buff->size++;
@@ -43,12 +53,31 @@ void push_back_fb(struct Float_Buffer* buff, float f)
 
 void push_back_ib(struct Index_Buffer* buff, int i)
 {
-    assert(buff->size < CAPACITY);
+    if (buff->size == buff->capacity)
+        buff->buffer = grow(buff->buffer, &buff->capacity, sizeof(int));
 
     buff->buffer[buff->size] = i;
     buff->size++;
 }
 
+void free_vb(struct Vertex_Buffer* buff)
+{
+    free(buff->buffer);
+    *buff = (Vertex_Buffer) {0};
+}
+
+void free_fb(struct Float_Buffer* buff)
+{
+    free(buff->buffer);
+    *buff = (Float_Buffer) {0};
+}
+
+void free_ib(struct Index_Buffer* buff)
+{
+    free(buff->buffer);
+    *buff = (Index_Buffer) {0};
+}
+
 
 void make_sphere_geom(Vertex_Buffer* buff, Index_Buffer* ibuff, int sectors, int stacks)
 {
@@ -105,10 +134,10 @@ void make_sphere_geom(Vertex_Buffer* buff, Index_Buffer* ibuff, int sectors, int
     }
 }
 
-void make_earth_geom(Vertex_Buffer* buff, Index_Buffer* ibuff)
+void make_earth_geom(Vertex_Buffer* buff, Index_Buffer* ibuff, int sectors, int stacks)
 {
-    int sectors = 32;
-    int stacks = 32;
+    assert(sectors > 1);
+    assert(stacks > 1);
     srand(time(0));
 
     float deltaTheta = (float) (2*M_PI)/sectors;
@@ -138,24 +167,48 @@ void make_earth_geom(Vertex_Buffer* buff, Index_Buffer* ibuff)
             push_back_vb(buff, (Vertex) {(Vec3) {x, y, z}, col, tex});
         }
     }
-    for(int i = 0; i < stacks/2; ++i)
+    make_earth_lod_indices(ibuff, sectors, stacks, 1);
+}
+
+const float earth_geom_map_rect[4] = {0.0f, 0.0f, 0.5f, 0.5f};
+
+/* Triangulates the make_earth_geom vertex grid using every step-th row and
+ * column, so coarser LODs share the full resolution vertex buffer. Returns
+ * the number of indices appended. */
+size_t make_earth_lod_indices(Index_Buffer* ibuff, int sectors, int stacks, int step)
+{
+    assert(step > 0);
+    assert((sectors/2) % step == 0);
+    assert((stacks/2) % step == 0);
+
+    size_t start = ibuff->size;
+    int row = sectors/2 + 1;
+    for(int i = 0; i < stacks/2; i += step)
     {
-        for(int j = 0; j < sectors/2; ++j)
+        for(int j = 0; j < sectors/2; j += step)
         {
-            int temp = i * (sectors/2 + 1) + j;
-            int temp2 = sectors/2 * (i + 1) + 1 + i + j;
+            int temp = i * row + j;
+            int temp2 = (i + step) * row + j;
 
-            push_back_ib(ibuff, temp + 1);
+            push_back_ib(ibuff, temp + step);
             push_back_ib(ibuff, temp);
             push_back_ib(ibuff, temp2);
 
-            push_back_ib(ibuff, temp + 1);
+            push_back_ib(ibuff, temp + step);
             push_back_ib(ibuff, temp2);
-            push_back_ib(ibuff, temp2 + 1);
+            push_back_ib(ibuff, temp2 + step);
         }
     }
+    return ibuff->size - start;
 }
 
+/* Inverse of the texture mapping used by make_earth_geom. */
+Vec3 earth_uv_to_pos(float s, float t)
+{
+    float theta = -1 * M_PI + s * M_PI;
+    float phi = t * (float) M_PI/2;
+    return (Vec3) {sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta)};
+}
 
 void make_circle_geom(Float_Buffer* buff, Index_Buffer* ibuff, int segments)
 {
@@ -3,12 +3,13 @@
 
 #include <stddef.h>
 
-#define CAPACITY 8192
+#define INITIAL_CAPACITY 1024
 
 typedef struct Float_Buffer
 {
-    float buffer[CAPACITY];
+    float* buffer;
     size_t size;
+    size_t capacity;
 }Float_Buffer;
 
 typedef struct Vec3
@@ -35,14 +36,16 @@ typedef struct Vertex
 
 typedef struct Vertex_Buffer
 {
-    Vertex buffer[CAPACITY];
+    Vertex* buffer;
     size_t size;
+    size_t capacity;
 }Vertex_Buffer;
 
 typedef struct Index_Buffer
 {
-    int buffer[CAPACITY];
+    int* buffer;
     size_t size;
+    size_t capacity;
 } Index_Buffer;
 
 Vec3 vec3_normalize(Vec3 v);
@@ -55,11 +58,25 @@ void push_back_fb(struct Float_Buffer* buff, float f);
 
 void push_back_ib(struct Index_Buffer* buff, int i);
 
+void free_vb(struct Vertex_Buffer* buff);
+
+void free_fb(struct Float_Buffer* buff);
+
+void free_ib(struct Index_Buffer* buff);
+
 void make_cube_geom_vb(Vertex_Buffer* buff, Index_Buffer* ibuff);
 
 void make_sphere_geom(Vertex_Buffer* buff, Index_Buffer* ibuff, int sectors, int stacks);
 
-void make_earth_geom(Vertex_Buffer* buff, Index_Buffer* ibuff);
+void make_earth_geom(Vertex_Buffer* buff, Index_Buffer* ibuff, int sectors, int stacks);
+/* make_earth_geom spans longitude -180..0 and latitude 90..0 only, so its
+ * uv covers this part of a whole earth map: u and v offset, then width and
+ * height, in the map's 0..1 coordinates with v running down from the pole. */
+extern const float earth_geom_map_rect[4];
+
+size_t make_earth_lod_indices(Index_Buffer* ibuff, int sectors, int stacks, int step);
+
+Vec3 earth_uv_to_pos(float s, float t);
     
 void make_circle_geom(Float_Buffer* buff, Index_Buffer* ibuff, int segments);
 
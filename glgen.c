@@ -0,0 +1,404 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Build step that writes a GL loader holding only the functions and flags
+ * the given sources name, in place of glad.c which declares and loads every
+ * entry point glad knows about. Signatures come from glad/glad.h so the
+ * generated file is a drop in for glad.c behind the same header. Functions
+ * passed with -e are resolved in gladLoadGLLoader, the rest start out as a
+ * stub that resolves the real entry point on the first call and replaces
+ * itself. Run by the makefile for GL_LOADER. */
+
+#define NAME_MAX_LENGTH 64
+#define TYPE_MAX_LENGTH 128
+#define PARAMS_MAX_LENGTH 512
+
+typedef struct GlFunction
+{
+    char name[NAME_MAX_LENGTH];
+    char type[NAME_MAX_LENGTH];
+    char result[TYPE_MAX_LENGTH];
+    char params[PARAMS_MAX_LENGTH];
+    bool used;
+    bool eager;
+}GlFunction;
+
+typedef struct GlFlag
+{
+    char name[NAME_MAX_LENGTH]; // without the GLAD_ prefix, GL_VERSION_4_1 or GL_KHR_debug
+    bool used;
+}GlFlag;
+
+typedef struct GlApi
+{
+    GlFunction* functions;
+    int function_count;
+    GlFlag* flags;
+    int flag_count;
+}GlApi;
+
+static void usage(const char* prog)
+{
+    printf("usage: %s glad.h out.c [-e function ...] [source ...]\n", prog);
+    printf("  -e resolves the function when the context is loaded instead of on its first call\n");
+}
+
+static char* read_file(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = size >= 0 ? malloc(size + 1) : NULL;
+    if (!data || fread(data, 1, size, file) != (size_t) size)
+    {
+        perror(path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    data[size] = '\0';
+    fclose(file);
+    return data;
+}
+
+static bool copy_text(char* out, size_t capacity, const char* begin, const char* end)
+{
+    while (begin < end && isspace((unsigned char) *begin))
+        begin++;
+    while (end > begin && isspace((unsigned char) end[-1]))
+        end--;
+    if ((size_t) (end - begin) >= capacity)
+        return false;
+    memcpy(out, begin, end - begin);
+    out[end - begin] = '\0';
+    return true;
+}
+
+/* glad writes each function as three lines,
+ *   typedef RESULT (APIENTRYP PFNGLNAMEPROC)(PARAMS);
+ *   GLAPI PFNGLNAMEPROC glad_glName;
+ *   #define glName glad_glName
+ * and each feature flag as GLAPI int GLAD_GL_NAME; */
+static bool parse_header(char* header, GlApi* api)
+{
+    int capacity = 0;
+    for (const char* c = header; (c = strstr(c, "\nGLAPI ")); ++c)
+        capacity++;
+    api->functions = calloc(capacity, sizeof(GlFunction));
+    api->flags = calloc(capacity, sizeof(GlFlag));
+    if (!api->functions || !api->flags)
+        return false;
+
+    GlFunction pending = {0};
+    for (char* line = header; line && *line; )
+    {
+        char* next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+
+        const char* proc = strstr(line, "(APIENTRYP ");
+        char name[NAME_MAX_LENGTH];
+        if (strncmp(line, "typedef ", 8) == 0 && proc)
+        {
+            const char* type = proc + strlen("(APIENTRYP ");
+            const char* type_end = strchr(type, ')');
+            const char* params = type_end ? strchr(type_end, '(') : NULL;
+            const char* params_end = params ? strrchr(params, ')') : NULL;
+            if (!params_end
+                || !copy_text(pending.result, sizeof(pending.result), line + 8, proc)
+                || !copy_text(pending.type, sizeof(pending.type), type, type_end)
+                || !copy_text(pending.params, sizeof(pending.params), params + 1, params_end))
+            {
+                printf("Error parsing GL header: %s\n", line);
+                return false;
+            }
+        }
+        else if (sscanf(line, "GLAPI int GLAD_%63[A-Za-z0-9_];", name) == 1)
+        {
+            snprintf(api->flags[api->flag_count++].name, NAME_MAX_LENGTH, "%s", name);
+        }
+        else if (strncmp(line, "GLAPI PFNGL", 11) == 0)
+        {
+            char type[NAME_MAX_LENGTH];
+            if (sscanf(line, "GLAPI %63s glad_%63[A-Za-z0-9_];", type, name) != 2 || strcmp(type, pending.type) != 0)
+            {
+                printf("Error parsing GL header, %s does not follow its typedef\n", line);
+                return false;
+            }
+            GlFunction* function = &api->functions[api->function_count++];
+            *function = pending;
+            snprintf(function->name, sizeof(function->name), "%s", name);
+        }
+        line = next;
+    }
+    return true;
+}
+
+static int compare_functions(const void* a, const void* b)
+{
+    return strcmp(((const GlFunction*) a)->name, ((const GlFunction*) b)->name);
+}
+
+static GlFunction* find_function(GlApi* api, const char* name)
+{
+    GlFunction key;
+    snprintf(key.name, sizeof(key.name), "%s", name);
+    return bsearch(&key, api->functions, api->function_count, sizeof(GlFunction), compare_functions);
+}
+
+static GlFlag* find_flag(GlApi* api, const char* name)
+{
+    for (int i = 0; i < api->flag_count; ++i)
+    {
+        if (strcmp(api->flags[i].name, name) == 0)
+            return &api->flags[i];
+    }
+    return NULL;
+}
+
+static void scan_source(GlApi* api, const char* source)
+{
+    for (const char* c = source; *c; )
+    {
+        if (!isalnum((unsigned char) *c) && *c != '_')
+        {
+            c++;
+            continue;
+        }
+        // numbers are skipped whole so a suffix like 1e6 can't start a name
+        const char* begin = c;
+        while (isalnum((unsigned char) *c) || *c == '_')
+            c++;
+        size_t length = c - begin;
+        if (isdigit((unsigned char) *begin) || length >= NAME_MAX_LENGTH)
+            continue;
+
+        char name[NAME_MAX_LENGTH];
+        memcpy(name, begin, length);
+        name[length] = '\0';
+        if (strncmp(name, "gl", 2) == 0 && isupper((unsigned char) name[2]))
+        {
+            GlFunction* function = find_function(api, name);
+            if (function)
+                function->used = true;
+        }
+        else if (strncmp(name, "GLAD_GL_", 8) == 0)
+        {
+            GlFlag* flag = find_flag(api, name + 5);
+            if (flag)
+                flag->used = true;
+        }
+    }
+}
+
+/* Argument list forwarding the parameters, the last name in each one. */
+static void write_arguments(FILE* out, const char* params)
+{
+    if (strcmp(params, "void") == 0)
+        return;
+    const char* begin = params;
+    for (;;)
+    {
+        const char* end = strchr(begin, ',');
+        if (!end)
+            end = begin + strlen(begin);
+        const char* name_end = end;
+        while (name_end > begin && !isalnum((unsigned char) name_end[-1]) && name_end[-1] != '_')
+            name_end--;
+        const char* name = name_end;
+        while (name > begin && (isalnum((unsigned char) name[-1]) || name[-1] == '_'))
+            name--;
+        fprintf(out, "%s%.*s", begin == params ? "" : ", ", (int) (name_end - name), name);
+        if (!*end)
+            break;
+        begin = end + 1;
+    }
+}
+
+static void write_lazy(FILE* out, const GlFunction* function)
+{
+    bool returns = strcmp(function->result, "void") != 0;
+    fprintf(out, "static %s APIENTRY lazy_%s(%s)\n{\n", function->result, function->name, function->params);
+    fprintf(out, "    glad_%s = (%s) resolve(\"%s\");\n", function->name, function->type, function->name);
+    fprintf(out, "    %sglad_%s(", returns ? "return " : "", function->name);
+    write_arguments(out, function->params);
+    fprintf(out, ");\n}\n");
+    fprintf(out, "%s glad_%s = lazy_%s;\n\n", function->type, function->name, function->name);
+}
+
+static void write_loader(FILE* out, const GlApi* api, const char* header_path)
+{
+    fprintf(out, "/* Generated by glgen from %s, do not edit. */\n", header_path);
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n#include \"glad/glad.h\"\n\n");
+    fprintf(out, "struct gladGLversionStruct GLVersion = { 0, 0 };\n");
+    int extension_count = 0;
+    for (int i = 0; i < api->flag_count; ++i)
+    {
+        if (!api->flags[i].used)
+            continue;
+        fprintf(out, "int GLAD_%s = 0;\n", api->flags[i].name);
+        if (strncmp(api->flags[i].name, "GL_VERSION_", 11) != 0)
+            extension_count++;
+    }
+
+    fprintf(out, "\nstatic GLADloadproc loader;\n\n");
+    fprintf(out, "static void* resolve(const char* name)\n{\n");
+    fprintf(out, "    void* proc = loader ? loader(name) : NULL;\n");
+    fprintf(out, "    if (!proc)\n    {\n");
+    fprintf(out, "        printf(\"Error resolving GL function %%s\\n\", name);\n");
+    fprintf(out, "        abort();\n    }\n    return proc;\n}\n\n");
+
+    for (int i = 0; i < api->function_count; ++i)
+    {
+        const GlFunction* function = &api->functions[i];
+        if (function->eager)
+            fprintf(out, "%s glad_%s = NULL;\n\n", function->type, function->name);
+        else if (function->used)
+            write_lazy(out, function);
+    }
+
+    if (extension_count)
+    {
+        fprintf(out, "static const char* const extension_names[] = {\n");
+        for (int i = 0; i < api->flag_count; ++i)
+        {
+            if (api->flags[i].used && strncmp(api->flags[i].name, "GL_VERSION_", 11) != 0)
+                fprintf(out, "    \"%s\",\n", api->flags[i].name);
+        }
+        fprintf(out, "};\nstatic int* const extension_flags[] = {\n");
+        for (int i = 0; i < api->flag_count; ++i)
+        {
+            if (api->flags[i].used && strncmp(api->flags[i].name, "GL_VERSION_", 11) != 0)
+                fprintf(out, "    &GLAD_%s,\n", api->flags[i].name);
+        }
+        fprintf(out, "};\n\n");
+        fprintf(out, "static void find_extensions(void)\n{\n");
+        fprintf(out, "    GLint count = 0;\n");
+        fprintf(out, "    glGetIntegerv(GL_NUM_EXTENSIONS, &count);\n");
+        fprintf(out, "    for (GLint i = 0; i < count; ++i)\n    {\n");
+        fprintf(out, "        const char* name = (const char*) glGetStringi(GL_EXTENSIONS, i);\n");
+        fprintf(out, "        for (int j = 0; name && j < %d; ++j)\n        {\n", extension_count);
+        fprintf(out, "            if (strcmp(name, extension_names[j]) == 0)\n");
+        fprintf(out, "                *extension_flags[j] = 1;\n");
+        fprintf(out, "        }\n    }\n}\n\n");
+    }
+
+    fprintf(out, "int gladLoadGLLoader(GLADloadproc load)\n{\n");
+    fprintf(out, "    loader = load;\n");
+    fprintf(out, "    GLVersion.major = 0; GLVersion.minor = 0;\n");
+    for (int i = 0; i < api->function_count; ++i)
+    {
+        const GlFunction* function = &api->functions[i];
+        if (!function->eager)
+            continue;
+        fprintf(out, "    if (!(glad_%s = (%s) load(\"%s\")))\n        return 0;\n", function->name, function->type, function->name);
+    }
+    // the version prefixes are the ones glad's find_coreGL strips
+    fprintf(out, "    const char* version = (const char*) glGetString(GL_VERSION);\n");
+    fprintf(out, "    if (!version)\n        return 0;\n");
+    fprintf(out, "    const char* prefixes[] = {\"OpenGL ES-CM \", \"OpenGL ES-CL \", \"OpenGL ES \"};\n");
+    fprintf(out, "    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i)\n    {\n");
+    fprintf(out, "        if (strncmp(version, prefixes[i], strlen(prefixes[i])) == 0)\n");
+    fprintf(out, "            version += strlen(prefixes[i]);\n    }\n");
+    fprintf(out, "    int major = 0, minor = 0;\n");
+    fprintf(out, "    sscanf(version, \"%%d.%%d\", &major, &minor);\n");
+    fprintf(out, "    GLVersion.major = major; GLVersion.minor = minor;\n");
+    for (int i = 0; i < api->flag_count; ++i)
+    {
+        int flag_major, flag_minor;
+        if (api->flags[i].used && sscanf(api->flags[i].name, "GL_VERSION_%d_%d", &flag_major, &flag_minor) == 2)
+        {
+            fprintf(out, "    GLAD_%s = (major == %d && minor >= %d) || major > %d;\n",
+                    api->flags[i].name, flag_major, flag_minor, flag_major);
+        }
+    }
+    if (extension_count)
+    {
+        // glGetStringi is all core profiles have, which is all this program creates
+        fprintf(out, "    if (major >= 3)\n        find_extensions();\n");
+    }
+    fprintf(out, "    return 1;\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    char* header = read_file(argv[1]);
+    GlApi api = {0};
+    if (!header || !parse_header(header, &api))
+        return 1;
+    qsort(api.functions, api.function_count, sizeof(GlFunction), compare_functions);
+
+    // what the loader itself calls, glGetString up front so a context without it fails the load like glad's
+    const char* loader_functions[] = {"glGetString", "glGetIntegerv", "glGetStringi"};
+    for (size_t i = 0; i < sizeof(loader_functions) / sizeof(loader_functions[0]); ++i)
+    {
+        GlFunction* function = find_function(&api, loader_functions[i]);
+        if (function)
+            function->used = true;
+        if (function && i == 0)
+            function->eager = true;
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            GlFunction* function = find_function(&api, argv[++i]);
+            if (!function)
+            {
+                printf("Error: %s is not a GL function in %s\n", argv[i], argv[1]);
+                return 1;
+            }
+            function->used = function->eager = true;
+            continue;
+        }
+        char* source = read_file(argv[i]);
+        if (!source)
+            return 1;
+        scan_source(&api, source);
+        free(source);
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (!out)
+    {
+        perror("Error creating GL loader source");
+        return 1;
+    }
+    write_loader(out, &api, argv[1]);
+    if (fclose(out) != 0)
+    {
+        perror("Error writing GL loader source");
+        remove(argv[2]);
+        return 1;
+    }
+
+    int used = 0, eager = 0, flags = 0;
+    for (int i = 0; i < api.function_count; ++i)
+    {
+        used += api.functions[i].used;
+        eager += api.functions[i].eager;
+    }
+    for (int i = 0; i < api.flag_count; ++i)
+        flags += api.flags[i].used;
+    printf("GL loader: %d of %d functions, %d resolved up front, %d of %d flags\n",
+           used, api.function_count, eager, flags, api.flag_count);
+    free(api.functions);
+    free(api.flags);
+    free(header);
+    return 0;
+}
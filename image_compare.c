@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "image_compare.h"
+
+// the usual SSIM stabilisers for 8 bit data, (0.01 * 255)^2 and (0.03 * 255)^2
+#define SSIM_C1 6.5025
+#define SSIM_C2 58.5225
+
+static float luma(const uint8_t* pixel, int channels)
+{
+    if (channels < 3)
+        return pixel[0];
+    return 0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2];
+}
+
+/* Windows step by half their size, which tracks the full sliding window
+ * closely at a sixteenth of the work. */
+static double mean_ssim(const float* a, const float* b, int width, int height)
+{
+    if (width < IMAGE_SSIM_WINDOW || height < IMAGE_SSIM_WINDOW)
+        return 1.0;
+    const double n = IMAGE_SSIM_WINDOW * IMAGE_SSIM_WINDOW;
+    double total = 0.0;
+    int windows = 0;
+    for (int y = 0; y + IMAGE_SSIM_WINDOW <= height; y += IMAGE_SSIM_STEP)
+    {
+        for (int x = 0; x + IMAGE_SSIM_WINDOW <= width; x += IMAGE_SSIM_STEP)
+        {
+            double sa = 0.0, sb = 0.0, saa = 0.0, sbb = 0.0, sab = 0.0;
+            for (int wy = 0; wy < IMAGE_SSIM_WINDOW; ++wy)
+            {
+                const float* ra = a + (size_t) (y + wy) * width + x;
+                const float* rb = b + (size_t) (y + wy) * width + x;
+                for (int wx = 0; wx < IMAGE_SSIM_WINDOW; ++wx)
+                {
+                    sa += ra[wx];
+                    sb += rb[wx];
+                    saa += ra[wx] * ra[wx];
+                    sbb += rb[wx] * rb[wx];
+                    sab += ra[wx] * rb[wx];
+                }
+            }
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += ((2.0 * ma * mb + SSIM_C1) * (2.0 * cov + SSIM_C2))
+                / ((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+            ++windows;
+        }
+    }
+    return total / windows;
+}
+
+void image_compare(const uint8_t* golden, const uint8_t* image, int width, int height, int channels,
+                   int threshold, ImageDiff* diff, uint8_t* heatmap)
+{
+    *diff = (ImageDiff) {.pixel_count = (uint64_t) width * height};
+    size_t count = (size_t) width * height;
+    float* luma_golden = malloc(count * sizeof(float));
+    float* luma_image = malloc(count * sizeof(float));
+
+    uint64_t sum = 0, sum_squares = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* a = golden + i * channels;
+        const uint8_t* b = image + i * channels;
+        int pixel_max = 0;
+        for (int c = 0; c < channels; ++c)
+        {
+            int d = abs(a[c] - b[c]);
+            sum += d;
+            sum_squares += (uint64_t) (d * d);
+            if (d > pixel_max)
+                pixel_max = d;
+        }
+        if (pixel_max > diff->max_diff)
+            diff->max_diff = pixel_max;
+        if (pixel_max > threshold)
+            diff->differing_pixels++;
+        if (heatmap)
+        {
+            uint8_t grey = (uint8_t) (luma(a, channels) * 0.25f);
+            heatmap[i * 3 + 0] = pixel_max > threshold ? (uint8_t) (128 + pixel_max / 2) : grey;
+            heatmap[i * 3 + 1] = grey;
+            heatmap[i * 3 + 2] = grey;
+        }
+        if (luma_golden && luma_image)
+        {
+            luma_golden[i] = luma(a, channels);
+            luma_image[i] = luma(b, channels);
+        }
+    }
+
+    double samples = (double) count * channels;
+    diff->mean_diff = sum / samples;
+    double mse = sum_squares / samples;
+    diff->psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+    diff->ssim = luma_golden && luma_image ? mean_ssim(luma_golden, luma_image, width, height) : NAN;
+    free(luma_golden);
+    free(luma_image);
+}
@@ -0,0 +1,26 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IMAGE_SSIM_WINDOW 8
+#define IMAGE_SSIM_STEP 4
+
+typedef struct ImageDiff
+{
+    int max_diff;              // largest difference in any channel
+    double mean_diff;          // over every channel of every pixel
+    uint64_t pixel_count;
+    uint64_t differing_pixels; // a channel differs by more than the threshold
+    double psnr;               // dB over all channels, INFINITY when identical
+    double ssim;               // mean over 8x8 luma windows, 1 when identical
+}ImageDiff;
+
+/* Compares two images of the same size and layout. When heatmap is not NULL
+ * it receives width * height RGB pixels: the golden image dimmed to grey,
+ * with differing pixels in red scaled by how far off they are. */
+void image_compare(const uint8_t* golden, const uint8_t* image, int width, int height, int channels,
+                   int threshold, ImageDiff* diff, uint8_t* heatmap);
+
+#endif // IMAGE_COMPARE_H
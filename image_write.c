@@ -0,0 +1,364 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_write.h"
+
+/* A small PNG encoder: per row adaptive filtering and one fixed Huffman
+ * deflate block fed by a hash chain matcher. Rendered frames are mostly
+ * flat colour, which this compresses well without pulling in zlib. */
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_CHAIN 32
+
+typedef struct ByteBuffer
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    uint32_t bits; // pending bits, LSB first
+    int bit_count;
+    bool failed;
+}ByteBuffer;
+
+static const uint16_t length_base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                       3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distance_base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                         257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distance_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                         7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void put_byte(ByteBuffer* buffer, uint8_t byte)
+{
+    if (buffer->size == buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 65536;
+        uint8_t* data = realloc(buffer->data, capacity);
+        if (!data)
+        {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    buffer->data[buffer->size++] = byte;
+}
+
+static void put_bits(ByteBuffer* buffer, uint32_t value, int count)
+{
+    buffer->bits |= value << buffer->bit_count;
+    buffer->bit_count += count;
+    while (buffer->bit_count >= 8)
+    {
+        put_byte(buffer, (uint8_t) buffer->bits);
+        buffer->bits >>= 8;
+        buffer->bit_count -= 8;
+    }
+}
+
+static void flush_bits(ByteBuffer* buffer)
+{
+    if (buffer->bit_count > 0)
+        put_byte(buffer, (uint8_t) buffer->bits);
+    buffer->bits = 0;
+    buffer->bit_count = 0;
+}
+
+// Huffman codes go out most significant bit first
+static void put_code(ByteBuffer* buffer, uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    put_bits(buffer, reversed, length);
+}
+
+static void put_literal(ByteBuffer* buffer, int symbol)
+{
+    if (symbol < 144)
+        put_code(buffer, 0x30 + symbol, 8);
+    else if (symbol < 256)
+        put_code(buffer, 0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        put_code(buffer, symbol - 256, 7);
+    else
+        put_code(buffer, 0xc0 + symbol - 280, 8);
+}
+
+static void put_match(ByteBuffer* buffer, int length, int distance)
+{
+    int code = 28;
+    while (length_base[code] > length)
+        --code;
+    put_literal(buffer, 257 + code);
+    put_bits(buffer, length - length_base[code], length_extra[code]);
+
+    code = 29;
+    while (distance_base[code] > distance)
+        --code;
+    put_code(buffer, code, 5);
+    put_bits(buffer, distance - distance_base[code], distance_extra[code]);
+}
+
+static uint32_t hash3(const uint8_t* p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        // 5552 is the most bytes before b can overflow
+        size_t n = size < 5552 ? size : 5552;
+        size -= n;
+        while (n--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+static bool zlib_compress(ByteBuffer* out, const uint8_t* data, size_t size)
+{
+    int32_t* head = malloc(HASH_SIZE * sizeof(int32_t));
+    int32_t* prev = malloc(WINDOW_SIZE * sizeof(int32_t));
+    if (!head || !prev)
+    {
+        free(head);
+        free(prev);
+        return false;
+    }
+    memset(head, 0xff, HASH_SIZE * sizeof(int32_t));
+
+    put_byte(out, 0x78); // deflate, 32K window
+    put_byte(out, 0x01);
+    put_bits(out, 1, 1); // final block
+    put_bits(out, 1, 2); // fixed Huffman codes
+
+    size_t i = 0;
+    while (i < size)
+    {
+        int best_length = 0, best_distance = 0;
+        if (i + MIN_MATCH <= size)
+        {
+            uint32_t h = hash3(data + i);
+            int32_t candidate = head[h];
+            size_t max_length = size - i < MAX_MATCH ? size - i : MAX_MATCH;
+            for (int chain = 0; candidate >= 0 && i - candidate <= WINDOW_SIZE && chain < MAX_CHAIN; ++chain)
+            {
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + i;
+                if (a[best_length] == b[best_length])
+                {
+                    size_t length = 0;
+                    while (length < max_length && a[length] == b[length])
+                        ++length;
+                    if ((int) length > best_length)
+                    {
+                        best_length = (int) length;
+                        best_distance = (int) (i - candidate);
+                        if (length == max_length)
+                            break;
+                    }
+                }
+                int32_t next = prev[candidate & WINDOW_MASK];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+
+        size_t advance = best_length >= MIN_MATCH ? (size_t) best_length : 1;
+        if (best_length >= MIN_MATCH)
+            put_match(out, best_length, best_distance);
+        else
+            put_literal(out, data[i]);
+        for (size_t end = i + advance; i < end; ++i)
+        {
+            if (i + MIN_MATCH > size)
+                continue;
+            uint32_t h = hash3(data + i);
+            prev[i & WINDOW_MASK] = head[h];
+            head[h] = (int32_t) i;
+        }
+    }
+    put_literal(out, 256);
+    flush_bits(out);
+
+    uint32_t adler = adler32(data, size);
+    put_byte(out, adler >> 24);
+    put_byte(out, adler >> 16);
+    put_byte(out, adler >> 8);
+    put_byte(out, adler);
+    free(head);
+    free(prev);
+    return !out->failed;
+}
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table(void)
+{
+    for (uint32_t n = 0; n < 256; ++n)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static bool write_u32(FILE* file, uint32_t value)
+{
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+    return fwrite(bytes, 1, 4, file) == 4;
+}
+
+static bool write_chunk(FILE* file, const char* type, const uint8_t* data, size_t size)
+{
+    uint32_t crc = crc32_update(0xffffffffu, (const uint8_t*) type, 4);
+    crc = crc32_update(crc, data, size) ^ 0xffffffffu;
+    return write_u32(file, (uint32_t) size) && fwrite(type, 1, 4, file) == 4
+        && (size == 0 || fwrite(data, 1, size, file) == size) && write_u32(file, crc);
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+/* Tries all five filters and keeps the one with the smallest sum of
+ * absolute signed residuals, the usual heuristic. */
+static void filter_row(uint8_t* out, const uint8_t* row, const uint8_t* above, size_t size, int bpp, uint8_t* scratch)
+{
+    uint32_t best_sum = UINT32_MAX;
+    for (int filter = 0; filter < 5; ++filter)
+    {
+        uint32_t sum = 0;
+        for (size_t x = 0; x < size; ++x)
+        {
+            int a = x >= (size_t) bpp ? row[x - bpp] : 0;
+            int b = above ? above[x] : 0;
+            int c = above && x >= (size_t) bpp ? above[x - bpp] : 0;
+            int predicted = 0;
+            switch (filter)
+            {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) / 2; break;
+            case 4: predicted = paeth(a, b, c); break;
+            }
+            uint8_t residual = (uint8_t) (row[x] - predicted);
+            scratch[x] = residual;
+            sum += residual < 128 ? residual : 256 - residual;
+        }
+        if (sum < best_sum)
+        {
+            best_sum = sum;
+            out[0] = (uint8_t) filter;
+            memcpy(out + 1, scratch, size);
+        }
+    }
+}
+
+bool image_write_png(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride)
+{
+    static const uint8_t color_types[] = {0, 0, 4, 2, 6};
+    if (channels < 1 || channels > 4 || width < 1 || height < 1)
+        return false;
+    pthread_once(&crc_once, init_crc_table);
+
+    size_t row_size = (size_t) width * channels;
+    uint8_t* filtered = malloc((row_size + 1) * height);
+    uint8_t* scratch = malloc(row_size);
+    ByteBuffer compressed = {0};
+    bool ok = filtered && scratch;
+    if (ok)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8_t* above = y > 0 ? pixels + (size_t) (y - 1) * stride : NULL;
+            filter_row(filtered + (size_t) y * (row_size + 1), pixels + (size_t) y * stride, above, row_size, channels, scratch);
+        }
+        ok = zlib_compress(&compressed, filtered, (row_size + 1) * height);
+    }
+    free(filtered);
+    free(scratch);
+
+    FILE* file = ok ? fopen(path, "wb") : NULL;
+    if (file)
+    {
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        uint8_t header[13] = {
+            width >> 24, width >> 16, width >> 8, width,
+            height >> 24, height >> 16, height >> 8, height,
+            8, color_types[channels], 0, 0, 0,
+        };
+        ok = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+            && write_chunk(file, "IHDR", header, sizeof(header))
+            && write_chunk(file, "IDAT", compressed.data, compressed.size)
+            && write_chunk(file, "IEND", NULL, 0);
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!file || !ok)
+    {
+        perror("Error writing PNG");
+        ok = false;
+    }
+    free(compressed.data);
+    return ok;
+}
+
+bool image_write_ppm(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride)
+{
+    if (channels != 1 && channels != 3)
+        return false;
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        perror("Error writing PPM");
+        return false;
+    }
+    fprintf(file, "P%d\n%d %d\n255\n", channels == 3 ? 6 : 5, width, height);
+    size_t row_size = (size_t) width * channels;
+    bool ok = true;
+    for (int y = 0; y < height && ok; ++y)
+        ok = fwrite(pixels + (size_t) y * stride, 1, row_size, file) == row_size;
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool image_write(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride)
+{
+    const char* extension = strrchr(path, '.');
+    if (extension && strcmp(extension, ".png") == 0)
+        return image_write_png(path, width, height, channels, pixels, stride);
+    return image_write_ppm(path, width, height, channels, pixels, stride);
+}
@@ -0,0 +1,15 @@
+#ifndef IMAGE_WRITE_H
+#define IMAGE_WRITE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* pixels are height rows of width * channels bytes, stride bytes apart.
+ * PNG takes 1 to 4 channels, PPM/PGM 1 or 3. */
+bool image_write_png(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride);
+bool image_write_ppm(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride);
+/* Picks the format from the extension, PNG for .png and PPM otherwise. */
+bool image_write(const char* path, int width, int height, int channels, const uint8_t* pixels, size_t stride);
+
+#endif // IMAGE_WRITE_H
@@ -0,0 +1,111 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "image_compare.h"
+#include "image_write.h"
+
+/* Golden image check for headless renders. Exits 0 when the candidate is
+ * within every tolerance given, 1 when it is not and 2 on bad input, so it
+ * can sit directly in a script after a --headless --dump run. */
+
+typedef struct Tolerances
+{
+    int threshold;         // per channel difference that still counts as equal
+    double max_pixels;     // differing pixels allowed, a fraction when percent is set
+    bool percent;
+    double min_psnr;       // 0 disables
+    double min_ssim;       // 0 disables
+    const char* diff_path; // heatmap output
+}Tolerances;
+
+static void usage(const char* prog)
+{
+    printf("usage: %s golden.png image.png [--threshold N] [--max-pixels N|N%%] [--min-psnr dB] [--min-ssim S] [--diff diff.png]\n", prog);
+    printf("  images are anything stb_image reads plus binary PPM, compared as RGB\n");
+    printf("  defaults: threshold 8, max-pixels 0, psnr and ssim unchecked\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    Tolerances tolerances = {.threshold = 8};
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            tolerances.threshold = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-pixels") == 0 && i + 1 < argc)
+        {
+            char* end;
+            tolerances.max_pixels = strtod(argv[++i], &end);
+            tolerances.percent = *end == '%';
+        }
+        else if (strcmp(argv[i], "--min-psnr") == 0 && i + 1 < argc)
+        {
+            tolerances.min_psnr = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-ssim") == 0 && i + 1 < argc)
+        {
+            tolerances.min_ssim = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc)
+        {
+            tolerances.diff_path = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    int width, height, channels, image_width, image_height;
+    uint8_t* golden = stbi_load(argv[1], &width, &height, &channels, 3);
+    uint8_t* image = stbi_load(argv[2], &image_width, &image_height, &channels, 3);
+    if (!golden || !image)
+    {
+        printf("failed to load %s: %s\n", golden ? argv[2] : argv[1], stbi_failure_reason());
+        return 2;
+    }
+    if (width != image_width || height != image_height)
+    {
+        printf("size mismatch: %dx%d golden, %dx%d image\n", width, height, image_width, image_height);
+        return 1;
+    }
+
+    ImageDiff diff;
+    uint8_t* heatmap = tolerances.diff_path ? malloc((size_t) width * height * 3) : NULL;
+    image_compare(golden, image, width, height, 3, tolerances.threshold, &diff, heatmap);
+    if (heatmap)
+    {
+        image_write(tolerances.diff_path, width, height, 3, heatmap, (size_t) width * 3);
+        free(heatmap);
+    }
+
+    double max_pixels = tolerances.percent ? tolerances.max_pixels / 100.0 * diff.pixel_count : tolerances.max_pixels;
+    bool pixels_ok = diff.differing_pixels <= max_pixels;
+    bool psnr_ok = tolerances.min_psnr <= 0.0 || diff.psnr >= tolerances.min_psnr;
+    bool ssim_ok = tolerances.min_ssim <= 0.0 || diff.ssim >= tolerances.min_ssim;
+
+    printf("%dx%d, max diff %d, mean diff %.4f\n", width, height, diff.max_diff, diff.mean_diff);
+    printf("pixels over %d: %lu (%.4f%%)%s\n", tolerances.threshold, (unsigned long) diff.differing_pixels,
+           100.0 * diff.differing_pixels / diff.pixel_count, pixels_ok ? "" : " FAIL");
+    if (isinf(diff.psnr))
+        printf("psnr: inf%s\n", psnr_ok ? "" : " FAIL");
+    else
+        printf("psnr: %.2f dB%s\n", diff.psnr, psnr_ok ? "" : " FAIL");
+    printf("ssim: %.6f%s\n", diff.ssim, ssim_ok ? "" : " FAIL");
+
+    stbi_image_free(golden);
+    stbi_image_free(image);
+    return pixels_ok && psnr_ok && ssim_ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "input.h"
+
+#define QUEUE_MASK (INPUT_QUEUE_CAPACITY - 1)
+
+_Static_assert((INPUT_QUEUE_CAPACITY & QUEUE_MASK) == 0, "input queue capacity must be a power of two");
+_Static_assert(INPUT_MAX_ACTIONS <= 127, "actions are stored as int8_t");
+
+bool input_queue_push(InputQueue* queue, const InputEvent* event)
+{
+    if (event->type == INPUT_EVENT_CURSOR && queue->tail != queue->head)
+    {
+        // keep the older timestamp, latency is how long the first move waited
+        InputEvent* last = &queue->events[(queue->tail - 1) & QUEUE_MASK];
+        if (last->type == INPUT_EVENT_CURSOR)
+        {
+            last->x = event->x;
+            last->y = event->y;
+            return true;
+        }
+    }
+    // a full queue drops new events, the ones already in it are older and still valid
+    if (queue->tail - queue->head == INPUT_QUEUE_CAPACITY)
+    {
+        queue->dropped++;
+        return false;
+    }
+    queue->events[queue->tail++ & QUEUE_MASK] = *event;
+    return true;
+}
+
+bool input_queue_pop(InputQueue* queue, InputEvent* event)
+{
+    if (queue->head == queue->tail)
+        return false;
+    *event = queue->events[queue->head++ & QUEUE_MASK];
+    return true;
+}
+
+void input_map_init(InputMap* map)
+{
+    *map = (InputMap) {0};
+    memset(map->keys, INPUT_UNBOUND, sizeof(map->keys));
+    memset(map->buttons, INPUT_UNBOUND, sizeof(map->buttons));
+}
+
+void input_map_bind_key(InputMap* map, int key, int action)
+{
+    if (key >= 0 && key < INPUT_KEY_CAPACITY && action < INPUT_MAX_ACTIONS)
+        map->keys[key] = (int8_t) action;
+}
+
+void input_map_bind_button(InputMap* map, int button, int action)
+{
+    if (button >= 0 && button < INPUT_BUTTON_CAPACITY && action < INPUT_MAX_ACTIONS)
+        map->buttons[button] = (int8_t) action;
+}
+
+void input_map_set_handler(InputMap* map, int action, InputActionFn on_press, void* context)
+{
+    if (action < 0 || action >= INPUT_MAX_ACTIONS)
+        return;
+    map->actions[action].on_press = on_press;
+    map->actions[action].context = context;
+}
+
+bool input_map_down(const InputMap* map, int action)
+{
+    return action >= 0 && action < INPUT_MAX_ACTIONS && map->actions[action].down;
+}
+
+static void apply_action(InputMap* map, int action, const InputEvent* event)
+{
+    if (action == INPUT_UNBOUND || event->action == GLFW_REPEAT)
+        return;
+    InputAction* a = &map->actions[action];
+    bool down = event->action == GLFW_PRESS;
+    if (down == a->down)
+        return;
+    a->down = down;
+    a->changed_ns = event->time_ns;
+    if (down && a->on_press)
+        a->on_press(a->context, event);
+}
+
+void input_map_apply(InputMap* map, const InputEvent* event)
+{
+    switch (event->type)
+    {
+    case INPUT_EVENT_KEY:
+        if (event->code >= 0 && event->code < INPUT_KEY_CAPACITY)
+            apply_action(map, map->keys[event->code], event);
+        break;
+    case INPUT_EVENT_MOUSE_BUTTON:
+        if (event->code < 0 || event->code >= INPUT_BUTTON_CAPACITY)
+            break;
+        if (event->action == GLFW_PRESS)
+            map->buttons_down |= 1u << event->code;
+        else
+            map->buttons_down &= ~(1u << event->code);
+        apply_action(map, map->buttons[event->code], event);
+        break;
+    case INPUT_EVENT_CURSOR:
+        map->cursor_x = event->x;
+        map->cursor_y = event->y;
+        break;
+    case INPUT_EVENT_SCROLL:
+        map->scroll_x += event->x;
+        map->scroll_y += event->y;
+        break;
+    }
+}
+
+void input_dispatch(InputQueue* queue, InputMap* map, uint64_t now_ns)
+{
+    map->scroll_x = 0.0;
+    map->scroll_y = 0.0;
+    map->oldest_event_ns = 0;
+    map->stats.dispatches++;
+    InputEvent event;
+    while (input_queue_pop(queue, &event))
+    {
+        uint64_t latency = now_ns > event.time_ns ? now_ns - event.time_ns : 0;
+        if (!map->oldest_event_ns)
+            map->oldest_event_ns = event.time_ns;
+        map->stats.events++;
+        map->stats.latency_ns += latency;
+        if (latency > map->stats.max_latency_ns)
+            map->stats.max_latency_ns = latency;
+        input_map_apply(map, &event);
+    }
+}
+
+void input_presented(InputMap* map, uint64_t present_ns)
+{
+    if (!map->oldest_event_ns || present_ns < map->oldest_event_ns)
+        return;
+    uint64_t latency = present_ns - map->oldest_event_ns;
+    map->stats.presents++;
+    map->stats.present_latency_ns += latency;
+    if (latency > map->stats.max_present_latency_ns)
+        map->stats.max_present_latency_ns = latency;
+    map->oldest_event_ns = 0;
+}
+
+void input_print_stats(const InputMap* map, uint64_t dropped)
+{
+    const InputStats* s = &map->stats;
+    printf("input: %lu events over %lu frames, %lu dropped\n", (unsigned long) s->events,
+           (unsigned long) s->dispatches, (unsigned long) dropped);
+    if (s->events)
+    {
+        printf("  event to dispatch mean %.3fms max %.3fms\n", s->latency_ns / 1e6 / s->events,
+               s->max_latency_ns / 1e6);
+    }
+    if (s->presents)
+    {
+        printf("  event to present mean %.3fms max %.3fms over %lu frames\n", s->present_latency_ns / 1e6 / s->presents,
+               s->max_present_latency_ns / 1e6, (unsigned long) s->presents);
+    }
+}
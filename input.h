@@ -0,0 +1,99 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GLFW/glfw3.h>
+
+#define INPUT_QUEUE_CAPACITY 256 // power of two
+#define INPUT_MAX_ACTIONS 32
+#define INPUT_KEY_CAPACITY (GLFW_KEY_LAST + 1)
+#define INPUT_BUTTON_CAPACITY (GLFW_MOUSE_BUTTON_LAST + 1)
+#define INPUT_UNBOUND (-1)
+
+typedef enum InputEventType
+{
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_MOUSE_BUTTON,
+    INPUT_EVENT_CURSOR,
+    INPUT_EVENT_SCROLL,
+}InputEventType;
+
+/* time_ns is when the event came out of the window system, which is when
+ * events are polled rather than when the device saw them. */
+typedef struct InputEvent
+{
+    uint64_t time_ns;
+    uint8_t type;
+    uint8_t action; // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int16_t code;   // key or mouse button
+    int32_t mods;
+    double x;       // cursor position or scroll offset
+    double y;
+}InputEvent;
+
+/* Filled by the window callbacks, drained once per frame. Consecutive cursor
+ * moves collapse into one event since only the last position matters. */
+typedef struct InputQueue
+{
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+    uint32_t head; // next to pop
+    uint32_t tail; // next to push
+    uint64_t dropped;
+}InputQueue;
+
+typedef void (*InputActionFn)(void* context, const InputEvent* event);
+
+typedef struct InputAction
+{
+    InputActionFn on_press; // may be NULL, held actions are read with input_map_down
+    void* context;
+    bool down;
+    uint64_t changed_ns;
+}InputAction;
+
+typedef struct InputStats
+{
+    uint64_t events;
+    uint64_t dispatches;
+    uint64_t latency_ns;     // summed event to dispatch time
+    uint64_t max_latency_ns;
+    uint64_t presents;       // frames that carried events to the screen
+    uint64_t present_latency_ns; // summed oldest event to present time
+    uint64_t max_present_latency_ns;
+}InputStats;
+
+/* Maps keys and mouse buttons onto application actions and keeps the state
+ * the rest of the frame reads. Only events cost anything, a bound key that
+ * isn't touched is never looked at. */
+typedef struct InputMap
+{
+    int8_t keys[INPUT_KEY_CAPACITY];
+    int8_t buttons[INPUT_BUTTON_CAPACITY];
+    InputAction actions[INPUT_MAX_ACTIONS];
+    uint32_t buttons_down; // bit per mouse button
+    double cursor_x;
+    double cursor_y;
+    double scroll_x; // accumulated over the last dispatch
+    double scroll_y;
+    uint64_t oldest_event_ns; // of the last dispatch, 0 when it had none
+    InputStats stats;
+}InputMap;
+
+bool input_queue_push(InputQueue* queue, const InputEvent* event);
+bool input_queue_pop(InputQueue* queue, InputEvent* event);
+
+void input_map_init(InputMap* map);
+void input_map_bind_key(InputMap* map, int key, int action);
+void input_map_bind_button(InputMap* map, int button, int action);
+void input_map_set_handler(InputMap* map, int action, InputActionFn on_press, void* context);
+bool input_map_down(const InputMap* map, int action);
+/* Applies one event to the map state and fires press handlers. */
+void input_map_apply(InputMap* map, const InputEvent* event);
+/* Drains the queue through the map, now_ns is the dispatch time for latency. */
+void input_dispatch(InputQueue* queue, InputMap* map, uint64_t now_ns);
+/* Call once the frame built from the last dispatch is on screen. */
+void input_presented(InputMap* map, uint64_t present_ns);
+void input_print_stats(const InputMap* map, uint64_t dropped);
+
+#endif // INPUT_H
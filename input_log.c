@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "input_log.h"
+
+#define KIND_TYPE_BITS 2
+
+_Static_assert(sizeof(InputLogEvent) == 12, "input log events are 12 bytes on disk");
+
+bool input_log_create(InputLog* log, const char* path, int width, int height, uint64_t frame_ns, double cursor_x, double cursor_y)
+{
+    *log = (InputLog) {
+        .recording = true,
+        .header = {
+            .magic = INPUT_LOG_MAGIC,
+            .version = INPUT_LOG_VERSION,
+            .width = (uint32_t) width,
+            .height = (uint32_t) height,
+            .frame_ns = frame_ns,
+            .cursor_x = (float) cursor_x,
+            .cursor_y = (float) cursor_y,
+        },
+    };
+    log->file = fopen(path, "wb");
+    if (!log->file)
+    {
+        perror("Error creating input log");
+        return false;
+    }
+    if (fwrite(&log->header, sizeof(log->header), 1, log->file) != 1)
+    {
+        perror("Error writing input log");
+        fclose(log->file);
+        log->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool input_log_open(InputLog* log, const char* path)
+{
+    *log = (InputLog) {0};
+    if (!map_file(path, &log->span, FILE_ACCESS_SEQUENTIAL))
+    {
+        perror("Error opening input log");
+        return false;
+    }
+    if (log->span.size < sizeof(InputLogHeader))
+    {
+        printf("%s: not an input log\n", path);
+        unmap_file(&log->span);
+        return false;
+    }
+    memcpy(&log->header, log->span.data, sizeof(InputLogHeader));
+    if (log->header.magic != INPUT_LOG_MAGIC || log->header.version != INPUT_LOG_VERSION)
+    {
+        printf("%s: not an input log or version %u, expected %u\n", path, log->header.version, INPUT_LOG_VERSION);
+        unmap_file(&log->span);
+        return false;
+    }
+    log->offset = sizeof(InputLogHeader);
+    return true;
+}
+
+void input_log_record(InputLog* log, uint32_t frame, InputQueue* queue)
+{
+    if (!log->file)
+        return;
+    log->header.frame_count = frame + 1;
+    uint32_t count = queue->tail - queue->head;
+    if (count == 0)
+        return;
+
+    InputLogEvent events[INPUT_QUEUE_CAPACITY];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        InputEvent* event = &queue->events[(queue->head + i) & (INPUT_QUEUE_CAPACITY - 1)];
+        event->x = (float) event->x;
+        event->y = (float) event->y;
+        events[i] = (InputLogEvent) {
+            .kind = (uint8_t) (event->type | event->mods << KIND_TYPE_BITS),
+            .action = event->action,
+            .code = event->code,
+            .x = (float) event->x,
+            .y = (float) event->y,
+        };
+    }
+    InputLogFrame block = {.frame = frame, .event_count = count};
+    if (fwrite(&block, sizeof(block), 1, log->file) != 1 || fwrite(events, sizeof(InputLogEvent), count, log->file) != count)
+    {
+        perror("Error writing input log, recording stopped");
+        fclose(log->file);
+        log->file = NULL;
+        return;
+    }
+    log->header.event_count += count;
+}
+
+void input_log_replay(InputLog* log, uint32_t frame, InputQueue* queue, uint64_t now_ns)
+{
+    while (log->offset + sizeof(InputLogFrame) <= log->span.size)
+    {
+        InputLogFrame block;
+        memcpy(&block, log->span.data + log->offset, sizeof(block));
+        if (block.frame > frame)
+            return;
+        size_t events_size = (size_t) block.event_count * sizeof(InputLogEvent);
+        if (events_size > log->span.size - log->offset - sizeof(block))
+        {
+            printf("input log is truncated at frame %u\n", block.frame);
+            log->offset = log->span.size;
+            return;
+        }
+        log->offset += sizeof(block);
+        // a block for an earlier frame only happens when frames were skipped, play it late rather than never
+        for (uint32_t i = 0; i < block.event_count; ++i)
+        {
+            InputLogEvent recorded;
+            memcpy(&recorded, log->span.data + log->offset + i * sizeof(InputLogEvent), sizeof(recorded));
+            InputEvent event = {
+                .time_ns = now_ns,
+                .type = recorded.kind & ((1u << KIND_TYPE_BITS) - 1),
+                .action = recorded.action,
+                .code = recorded.code,
+                .mods = recorded.kind >> KIND_TYPE_BITS,
+                .x = recorded.x,
+                .y = recorded.y,
+            };
+            input_queue_push(queue, &event);
+        }
+        log->offset += events_size;
+    }
+}
+
+bool input_log_close(InputLog* log)
+{
+    bool ok = true;
+    if (log->recording && log->file)
+    {
+        // the counts are only known now
+        ok = fseek(log->file, 0, SEEK_SET) == 0 && fwrite(&log->header, sizeof(log->header), 1, log->file) == 1;
+        ok = fclose(log->file) == 0 && ok;
+        if (!ok)
+            perror("Error finishing input log");
+    }
+    else if (!log->recording && log->span.data)
+    {
+        unmap_file(&log->span);
+    }
+    *log = (InputLog) {0};
+    return ok;
+}
@@ -0,0 +1,66 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "input.h"
+#include "util.h"
+
+#define INPUT_LOG_MAGIC 0x54504e49 // "INPT"
+#define INPUT_LOG_VERSION 1
+
+/* Native endian, like the other caches. frame_count and event_count are
+ * patched in when recording finishes. */
+typedef struct InputLogHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;  // window size the cursor positions are relative to
+    uint32_t height;
+    uint64_t frame_ns; // simulation clock step per frame
+    double cursor_x;   // where the cursor was before the first event
+    double cursor_y;
+    uint32_t frame_count;
+    uint32_t event_count;
+}InputLogHeader;
+
+/* Only frames that saw input get a block, each followed by its events. */
+typedef struct InputLogFrame
+{
+    uint32_t frame;
+    uint32_t event_count;
+}InputLogFrame;
+
+/* 12 bytes per event. Positions drop to float, which is exact for whole and
+ * half pixels, and the replay only ever sees the float values. */
+typedef struct InputLogEvent
+{
+    uint8_t kind;   // InputEventType in the low 2 bits, GLFW mods above
+    uint8_t action;
+    int16_t code;
+    float x;
+    float y;
+}InputLogEvent;
+
+typedef struct InputLog
+{
+    bool recording;
+    FILE* file;    // recording
+    FileSpan span; // replaying
+    size_t offset; // next frame block in span
+    InputLogHeader header;
+}InputLog;
+
+bool input_log_create(InputLog* log, const char* path, int width, int height, uint64_t frame_ns, double cursor_x, double cursor_y);
+bool input_log_open(InputLog* log, const char* path);
+/* Appends what is queued for this frame without consuming it. Queued
+ * positions are rounded to what the log stores, so the recording session
+ * sees exactly what a replay will. */
+void input_log_record(InputLog* log, uint32_t frame, InputQueue* queue);
+/* Queues the events recorded for frame, stamped with now_ns. */
+void input_log_replay(InputLog* log, uint32_t frame, InputQueue* queue, uint64_t now_ns);
+bool input_log_close(InputLog* log);
+
+#endif // INPUT_LOG_H
@@ -3,11 +3,10 @@
 #include <stdbool.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 
-#include<sys/time.h>
-
 #include "glad/glad.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -15,17 +14,152 @@
 #include "transform.h"
 #include "render_window.h"
 #include "geom.h"
+#include "mesh_cache.h"
+#include "virtual_texture.h"
+#include "mipmap.h"
+#include "pixel_convert.h"
+#include "texture_pack.h"
+#include "texture_stream.h"
+#include "cubemap.h"
+#include "program_cache.h"
+#include "shader_variant.h"
+#include "asset_watch.h"
+#include "assets.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "frame_scheduler.h"
+#include "simulation.h"
+#include "render_pipeline.h"
+#include "command_buffer.h"
+#include "input.h"
+#include "input_log.h"
 #include "camera.h"
 
 #define SEGMENTS 36
+#define EARTH_SECTORS 32
+#define EARTH_STACKS 32
 
 #define FPS 60
-#define US_PER_FRAME 1*1000*1000/FPS
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define ASPECT_RATIO ((float) WINDOW_WIDTH/WINDOW_HEIGHT)
 #define FOV M_PI/4
 #define CUBE_COUNT 3
+#define EARTH_TEXTURE "earth00.jpg"
+#define EARTH_PACK "earth.pack" // the four quadrants earth00.jpg is one of, the cube map covers the whole sphere
+#define MOON_SHELL_RADIUS 1.3f
+#define MOON_SCALE 0.02f
+#define MOON_LOD 2
+
+// command buffer ids, the GL backend maps them onto its objects
+#define PASS_OPAQUE 0
+#define SHADER_GLOBE 0
+#define SHADER_COUNT 1
+#define TEXTURE_EARTH 0
+#define TEXTURE_COUNT 1
+#define MESH_EARTH 0
+#define MESH_MOON 1
+#define MESH_COUNT 2
+
+#define HEADLESS_DEFAULT_FRAMES 300
+#define CUBE_MAP_UNIT 3 // samplers of different types may not share a unit, texture1 and the vt ones use 0-2
+#define ASSET_SHADER 0 // watched asset tags
+#define ASSET_TEXTURE 1
+
+typedef enum Action
+{
+    ACTION_QUIT,
+    ACTION_MOVE_FORWARD,
+    ACTION_MOVE_BACKWARD,
+    ACTION_MOVE_RIGHT,
+    ACTION_MOVE_LEFT,
+}Action;
+
+typedef struct Options
+{
+    bool virtual_texture;
+    bool headless;
+    int frame_limit;
+    const char* dump_path;
+    const char* profile_path;
+    const char* benchmark_path;
+    const char* camera_path;
+    double fps; // 0 is unlimited
+    bool vsync;
+    bool late_input;
+    double sim_hz;
+    bool sim_thread;
+    bool pipeline;
+    int object_count;
+    const char* record_path;
+    const char* replay_path;
+    const char* pack_path;
+    bool cube_map;
+    bool watch;
+}Options;
+
+/* What the frame builder reads. It runs on the render worker when the
+ * pipeline is threaded, so nothing in here may touch GL. */
+typedef struct Scene
+{
+    Simulation* sim;
+    const CameraPath* camera_path; // benchmark runs own the camera
+    int object_count;
+    uint64_t start_ns;
+    uint64_t fixed_frame_ns; // when set the simulation clock advances per frame, not with the wall clock
+    float far; // depth range for sort keys
+    float projection[MATRIX_SIZE];
+}Scene;
+
+typedef struct GlShader
+{
+    unsigned int program;
+    int model_loc;
+    int view_loc;
+    int projection_loc;
+    int packed_grid_loc;
+    int packed_masks_loc;
+    int packed_rect_loc;
+    int cube_map_loc;
+    VirtualTextureUniforms vt_uniforms;
+}GlShader;
+
+typedef struct GlMesh
+{
+    unsigned int vao;
+    unsigned int ebo;
+    int index_count;
+    GLenum index_type;
+    void* index_offset;
+}GlMesh;
+
+/* The GL side of command execution. Per frame state comes from the packet
+ * being executed, everything else is looked up by the ids in the keys. */
+typedef struct GlBackend
+{
+    const FramePacket* packet;
+    VirtualTexture* virtual_texture; // NULL for plain textures
+    const PackManifest* pack; // NULL unless the texture holds packed maps
+    float pack_masks[TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID][4];
+    bool cube_map; // textures are cube maps sampled by direction
+    GlShader shaders[SHADER_COUNT];
+    unsigned int textures[TEXTURE_COUNT];
+    GlMesh meshes[MESH_COUNT];
+    const GlShader* shader;
+    const GlMesh* mesh;
+}GlBackend;
+
+/* Reloading of edited assets. The watcher thread only marks files, all the
+ * GL work happens here between frames, and whatever is being rebuilt stays
+ * off screen until it is complete. */
+typedef struct HotReload
+{
+    AssetWatch watch;
+    ShaderPermutation permutation; // of the globe program
+    ProgramBuild program;          // relinking the globe program, the running one stays bound meanwhile
+    TextureStream stream;          // the reloaded earth texture, swapped in once its proxy levels are up
+    int reloads;
+}HotReload;
 
 RenderWindow window = {0};
 Camera camera = {.position = (Vec3) {0.0f, 0.0f, -1.5f},
@@ -33,113 +167,706 @@ Camera camera = {.position = (Vec3) {0.0f, 0.0f, -1.5f},
                  .target = (Vec3) {0.0f, 0.0f, 1.0f},
 };
 
-bool compile_shader(const char* shader_src, int type, unsigned int* shader_handle)
+static void quit(void* context, const InputEvent* event)
+{
+    (void) event;
+    render_window_request_close(context);
+}
+
+// held keys only set a direction, the simulation turns it into movement at a fixed rate
+static Vec3 move_direction(const InputMap* map)
+{
+    return (Vec3) {
+        (float) input_map_down(map, ACTION_MOVE_RIGHT) - (float) input_map_down(map, ACTION_MOVE_LEFT),
+        0.0f,
+        (float) input_map_down(map, ACTION_MOVE_FORWARD) - (float) input_map_down(map, ACTION_MOVE_BACKWARD),
+    };
+}
+
+void mouse_click(void)
+{
+    double x, y;
+    render_window_get_mouse_pos(&window, &x, &y);
+    printf("mouse clicked at %f, %f\n", x, y);
+}
+
+static GLenum texture_format(int channels)
 {
-    *shader_handle = glCreateShader(type);
-    glShaderSource(*shader_handle, 1, &shader_src, NULL);
-    glCompileShader(*shader_handle);
+    switch(channels)
+    {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    default: return GL_RGBA;
+    }
+}
 
-    int success;
-    char infoLog[512];
-    glGetShaderiv(*shader_handle, GL_COMPILE_STATUS, &success);
-    if (!success)
+/* Converts every level of the chain straight into one mapped pixel unpack
+ * buffer, then points glTexImage2D at offsets inside it. target is
+ * GL_TEXTURE_2D or a cube map face. */
+static bool upload_mips(GLenum target, const MipChain* mips, const PixelConversion* conversion)
+{
+    size_t offsets[MIP_MAX_LEVELS];
+    size_t total = 0;
+    for(int level = 0; level < mips->level_count; ++level)
     {
-        glGetShaderInfoLog(*shader_handle, 512, NULL, infoLog);
-        printf("ERROR::SHADER::%s::COMPILATION_FAILED\n%s", type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT", infoLog);
+        offsets[level] = total;
+        total += (size_t) mips->levels[level].width * mips->levels[level].height * conversion->dst_channels;
+    }
+
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) total, NULL, GL_STREAM_DRAW);
+    uint8_t* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) total, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(!mapped)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);
         return false;
     }
+    for(int level = 0; level < mips->level_count; ++level)
+    {
+        const MipLevel* mip = &mips->levels[level];
+        pixel_convert(conversion, mip->data, mapped + offsets[level], (size_t) mip->width * mip->height);
+    }
+    bool ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 
-    return true;
+    GLenum format = texture_format(conversion->dst_channels);
+    // odd sized levels have rows that aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(int level = 0; ok && level < mips->level_count; ++level)
+    {
+        const MipLevel* mip = &mips->levels[level];
+        glTexImage2D(target, level, format, mip->width, mip->height, 0, format, GL_UNSIGNED_BYTE, (void*)(uintptr_t) offsets[level]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    // the driver keeps the storage alive until the copies finish
+    glDeleteBuffers(1, &pbo);
+    return ok;
 }
 
-void move_eye_forward(void)
+static unsigned int create_texture(const uint8_t* data, int width, int height, int channels)
 {
-    camera.position = (Vec3) {camera.position.x, camera.position.y, camera.position.z + 0.01f};
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    MipChain mips;
+    MipOptions mip_options = {.filter = MIP_FILTER_KAISER, .color_space = MIP_COLOR_LINEAR};
+    PixelConversion conversion = pixel_conversion_make(channels, 0);
+    if(data && mip_chain_build(&mips, data, width, height, channels, &mip_options))
+    {
+        if(upload_mips(GL_TEXTURE_2D, &mips, &conversion))
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.level_count - 1);
+        else
+            printf("Failed to upload texture");
+        mip_chain_free(&mips);
+    }
+    else
+    {
+        printf("Failed to load texture");
+    }
+    return texture;
 }
 
-void move_eye_backward(void)
+/* One RGBA texture instead of a texture per map: one unit, one sampler and
+ * one fetch in the shader, and the same texel bytes either way. */
+static unsigned int load_packed_texture(const PackManifest* manifest)
 {
-    camera.position = (Vec3) {camera.position.x, camera.position.y, camera.position.z - 0.01f};
+    PackedTexture packed;
+    if(!texture_pack_build(&packed, manifest))
+        return 0;
+    unsigned int texture = create_texture(packed.pixels, packed.width, packed.height, TEXTURE_PACK_CHANNELS);
+    printf("packed %d maps of %dx%d into one rgba texture: %.1fMB as separate r8 textures, %.1fMB packed, %d fewer texture units\n",
+           manifest->channel_count, packed.width, packed.height, packed.separate_bytes / 1e6,
+           (double) packed.width * packed.height * TEXTURE_PACK_CHANNELS / 1e6, manifest->channel_count - 1);
+    texture_pack_free(&packed);
+    return texture;
 }
 
-void move_eye_right(void)
+/* Lays the pack's tiles out as one full sphere equirect, reprojects it into
+ * six faces on the CPU and uploads them with a mip chain each. Sampled by
+ * direction, the poles no longer take as many texels as the equator. */
+static unsigned int load_cube_texture(const PackManifest* manifest)
 {
-    camera.position = (Vec3) {camera.position.x + 0.01, camera.position.y, camera.position.z};
+    int width = 0, height = 0, channels = 1;
+    uint8_t* data = texture_pack_mosaic(manifest, &width, &height);
+    Cubemap cube;
+    uint64_t start = time_now_ns();
+    if(!data || !cubemap_from_equirect(&cube, data, width, height, channels, cubemap_equal_face_size(width), NULL))
+    {
+        free(data);
+        return 0;
+    }
+    free(data);
+    uint64_t reprojected = time_now_ns();
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    MipOptions mip_options = {.filter = MIP_FILTER_KAISER, .color_space = MIP_COLOR_LINEAR};
+    PixelConversion conversion = pixel_conversion_make(channels, 0);
+    bool ok = true;
+    int level_count = 1;
+    for(int face = 0; ok && face < CUBEMAP_FACES; ++face)
+    {
+        MipChain mips;
+        ok = mip_chain_build(&mips, cube.faces[face], cube.face_size, cube.face_size, channels, &mip_options);
+        if(ok)
+        {
+            ok = upload_mips(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, &mips, &conversion);
+            level_count = mips.level_count;
+            mip_chain_free(&mips);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    double equirect_texels = (double) width * height;
+    double cube_texels = (double) CUBEMAP_FACES * cube.face_size * cube.face_size;
+    printf("cube map: %dx%d tiles as a %dx%d equirect to 6 x %d^2 faces in %.1fms, %.2fM texels instead of %.2fM (%.0f%% fewer)\n",
+           manifest->grid_x, manifest->grid_y, width, height, cube.face_size, (reprojected - start) / 1e6, cube_texels / 1e6, equirect_texels / 1e6,
+           100.0 * (1.0 - cube_texels / equirect_texels));
+    cubemap_free(&cube);
+    if(!ok)
+    {
+        glDeleteTextures(1, &texture);
+        return 0;
+    }
+    return texture;
 }
 
-void move_eye_left(void)
+static GlShader gl_shader(unsigned int program)
 {
-    camera.position = (Vec3) {camera.position.x - 0.01, camera.position.y, camera.position.z};
+    return (GlShader) {
+        .program = program,
+        .model_loc = glGetUniformLocation(program, "model"),
+        .view_loc = glGetUniformLocation(program, "view"),
+        .projection_loc = glGetUniformLocation(program, "projection"),
+        .packed_grid_loc = glGetUniformLocation(program, "pack_grid"),
+        .packed_masks_loc = glGetUniformLocation(program, "pack_masks"),
+        .packed_rect_loc = glGetUniformLocation(program, "pack_rect"),
+        .cube_map_loc = glGetUniformLocation(program, "cube_map"),
+        .vt_uniforms = virtual_texture_uniforms(program),
+    };
 }
 
-void mouse_click(void)
+static void gl_bind_shader(void* context, uint32_t shader)
 {
-    double x, y;
-    render_window_get_mouse_pos(&window, &x, &y);
-    printf("mouse clicked at %f, %f\n", x, y);
+    GlBackend* gl = context;
+    gl->shader = &gl->shaders[shader];
+    glUseProgram(gl->shader->program);
+    glUniformMatrix4fv(gl->shader->view_loc, 1, GL_TRUE, gl->packet->view);
+    glUniformMatrix4fv(gl->shader->projection_loc, 1, GL_TRUE, gl->packet->projection);
+    if(gl->pack)
+    {
+        glUniform2f(gl->shader->packed_grid_loc, (float) gl->pack->grid_x, (float) gl->pack->grid_y);
+        glUniform4fv(gl->shader->packed_masks_loc, TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID, &gl->pack_masks[0][0]);
+        // the globe is one quadrant, only its tile of the pack shows
+        glUniform4fv(gl->shader->packed_rect_loc, 1, earth_geom_map_rect);
+    }
+    glUniform1i(gl->shader->cube_map_loc, CUBE_MAP_UNIT);
+    // the virtual texture is uniforms as much as textures, so it follows the program
+    if(gl->virtual_texture)
+        virtual_texture_bind(gl->virtual_texture, &gl->shader->vt_uniforms, 1, 2);
+}
+
+static void gl_bind_texture(void* context, uint32_t texture)
+{
+    GlBackend* gl = context;
+    if(gl->cube_map)
+    {
+        glActiveTexture(GL_TEXTURE0 + CUBE_MAP_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, gl->textures[texture]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else if(!gl->virtual_texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, gl->textures[texture]);
+    }
 }
 
-int main()
+static void gl_bind_mesh(void* context, uint32_t mesh)
 {
+    GlBackend* gl = context;
+    gl->mesh = &gl->meshes[mesh];
+    glBindVertexArray(gl->mesh->vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->mesh->ebo);
+}
 
-    render_window_init(&window, WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGl");
-    render_window_add_callback(&window, GLFW_KEY_W, &move_eye_forward);
-    render_window_add_callback(&window, GLFW_KEY_S, &move_eye_backward);
-    render_window_add_callback(&window, GLFW_KEY_D, &move_eye_right);
-    render_window_add_callback(&window, GLFW_KEY_A, &move_eye_left);
-    
-    Index_Buffer ibuff = {0};
-    Vertex_Buffer vbuff = {0};
-    make_earth_geom(&vbuff, &ibuff);
+static void gl_draw(void* context, uint32_t mesh, const void* payload, uint32_t payload_size)
+{
+    GlBackend* gl = context;
+    (void) mesh;
+    assert(payload_size == MATRIX_SIZE * sizeof(float));
+    glUniformMatrix4fv(gl->shader->model_loc, 1, GL_TRUE, payload);
+    glDrawElements(GL_TRIANGLES, gl->mesh->index_count, gl->mesh->index_type, gl->mesh->index_offset);
+}
 
-    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+static void hot_reload_watch_shaders(HotReload* reload, const ShaderText* text)
+{
+    for(int i = 0; i < text->file_count; ++i)
+        asset_watch_add(&reload->watch, text->files[i], ASSET_SHADER);
+}
+
+static void hot_reload_watch_textures(HotReload* reload, const Options* options, const PackManifest* pack)
+{
+    if(options->virtual_texture)
     {
-        printf("Failed to initialize GLAD");
-        return -1;
+        printf("hot reload: virtual texture pages are baked ahead, %s is not watched\n", EARTH_TEXTURE);
+    }
+    else if(options->pack_path || options->cube_map)
+    {
+        asset_watch_add(&reload->watch, options->pack_path ? options->pack_path : EARTH_PACK, ASSET_TEXTURE);
+        for(int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+        {
+            if(pack->channels[i].path[0])
+                asset_watch_add(&reload->watch, pack->channels[i].path, ASSET_TEXTURE);
+        }
     }
+    else
+    {
+        asset_watch_add(&reload->watch, EARTH_TEXTURE, ASSET_TEXTURE);
+    }
+}
 
-    char *vertex_shader_src, *fragment_shader_src;
-    if(!(vertex_shader_src = read_file("vertex.glsl")))
+static void hot_reload_shaders(HotReload* reload, ProgramBuild* startup_build, GlBackend* gl)
+{
+    // the startup program must not land on top of a newer one
+    if(startup_build->state == PROGRAM_BUILD_PENDING)
     {
-        perror("Error reading vertex shader file");
-        exit(0);
+        program_cache_wait(startup_build);
+        if(startup_build->state == PROGRAM_BUILD_READY)
+            gl->shaders[SHADER_GLOBE] = gl_shader(startup_build->program);
     }
-    if(!(fragment_shader_src = read_file("fragment.glsl")))
+    if(reload->program.state == PROGRAM_BUILD_PENDING)
     {
-        perror("Error reading fragment shader file");
-        exit(0);
+        program_cache_wait(&reload->program);
+        glDeleteProgram(reload->program.program);
     }
 
-    unsigned int vs, fs;
-    if(!compile_shader(vertex_shader_src, GL_VERTEX_SHADER, &vs))
+    ShaderText vertex_text, fragment_text;
+    if(!shader_preprocess("vertex.glsl", &vertex_text))
+        return;
+    if(!shader_preprocess("fragment.glsl", &fragment_text))
     {
-        perror("Error compiling vertex shader file");
-        exit(0);
+        shader_text_free(&vertex_text);
+        return;
     }
-    if(!compile_shader(fragment_shader_src, GL_FRAGMENT_SHADER, &fs))
+    // an edit may have added includes
+    hot_reload_watch_shaders(reload, &vertex_text);
+    hot_reload_watch_shaders(reload, &fragment_text);
+    ShaderVariant variant;
+    shader_variant_init(&variant, "globe", &reload->permutation, &vertex_text, &fragment_text);
+    program_cache_submit(&reload->program, &variant.source);
+    shader_text_free(&vertex_text);
+    shader_text_free(&fragment_text);
+}
+
+static void hot_reload_textures(HotReload* reload, const Options* options, GlBackend* gl, PackManifest* pack, unsigned int* texture)
+{
+    if(options->virtual_texture)
+        return;
+    if(!gl->pack && !gl->cube_map)
     {
-        perror("Error compiling fragment shader file");
-        exit(0);
+        // a fresh stream rebakes its mip cache, the source no longer matches it
+        if(reload->stream.texture)
+            texture_stream_close(&reload->stream);
+        if(!texture_stream_open(&reload->stream, EARTH_TEXTURE) && reload->stream.texture)
+            texture_stream_close(&reload->stream);
+        return;
     }
 
-    free(vertex_shader_src);
-    free(fragment_shader_src);
+    // packing and reprojection are not streamed, the frame waits for them
+    unsigned int reloaded = 0;
+    PackManifest manifest;
+    if(gl->pack && pack_manifest_load(&manifest, options->pack_path) && (reloaded = load_packed_texture(&manifest)))
+    {
+        *pack = manifest;
+        texture_pack_tile_masks(gl->pack, gl->pack_masks);
+        hot_reload_watch_textures(reload, options, pack);
+    }
+    else if(gl->cube_map && pack_manifest_load(&manifest, EARTH_PACK) && (reloaded = load_cube_texture(&manifest)))
+    {
+        *pack = manifest;
+        hot_reload_watch_textures(reload, options, pack);
+    }
+    if(!reloaded)
+        return;
+    glDeleteTextures(1, texture);
+    *texture = gl->textures[TEXTURE_EARTH] = reloaded;
+    reload->reloads++;
+}
 
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vs);
-    glAttachShader(shaderProgram, fs);
-    glLinkProgram(shaderProgram);
+/* Called once per frame, costs one atomic load until something changes. */
+static void hot_reload_update(HotReload* reload, const Options* options, ProgramBuild* startup_build, GlBackend* gl,
+                              unsigned int fallback_program, PackManifest* pack, TextureStream* earth_stream,
+                              unsigned int* texture)
+{
+    if(asset_watch_pending(&reload->watch))
+    {
+        bool shaders = false, textures = false;
+        for(int i; (i = asset_watch_next(&reload->watch)) >= 0;)
+        {
+            printf("hot reload: %s changed\n", reload->watch.assets[i].path);
+            shaders |= reload->watch.assets[i].tag == ASSET_SHADER;
+            textures |= reload->watch.assets[i].tag == ASSET_TEXTURE;
+        }
+        if(shaders)
+            hot_reload_shaders(reload, startup_build, gl);
+        if(textures)
+            hot_reload_textures(reload, options, gl, pack, texture);
+    }
+
+    // a cache hit is ready straight from the submit
+    if(reload->program.state != PROGRAM_BUILD_NONE && program_cache_poll(&reload->program))
+    {
+        if(reload->program.state == PROGRAM_BUILD_READY)
+        {
+            if(gl->shaders[SHADER_GLOBE].program != fallback_program)
+                glDeleteProgram(gl->shaders[SHADER_GLOBE].program);
+            gl->shaders[SHADER_GLOBE] = gl_shader(reload->program.program);
+            printf("hot reload: program swapped %.1fms after the change\n", reload->program.stats.ns / 1e6);
+            reload->reloads++;
+        }
+        else
+        {
+            printf("hot reload: keeping the running program\n");
+        }
+        // the live program belongs to gl now
+        reload->program.state = PROGRAM_BUILD_NONE;
+    }
 
-    int success;
-    char infoLog[512];
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    if(reload->stream.texture)
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", infoLog);
+        texture_stream_update(&reload->stream, TEXTURE_STREAM_FRAME_BUDGET);
+        if(reload->stream.state == TEXTURE_STREAM_FAILED)
+        {
+            texture_stream_close(&reload->stream);
+        }
+        else if(reload->stream.proxy_ns)
+        {
+            // the baker is done once there is a proxy, nothing points at the old struct
+            texture_stream_close(earth_stream);
+            *earth_stream = reload->stream;
+            reload->stream = (TextureStream) {0};
+            *texture = gl->textures[TEXTURE_EARTH] = earth_stream->texture;
+            printf("hot reload: %s swapped %.1fms after the change\n", EARTH_TEXTURE, (earth_stream->proxy_ns - earth_stream->start_ns) / 1e6);
+            reload->reloads++;
+        }
     }
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+}
+
+/* Earth first, then object_count - 1 small globes spread over a shell
+ * around it, each spinning, so the object count can be pushed high. */
+static void build_frame(FramePacket* packet, void* user)
+{
+    Scene* scene = user;
+    uint64_t now = scene->fixed_frame_ns ? scene->start_ns + (packet->frame + 1) * scene->fixed_frame_ns : time_now_ns();
+    SimState state;
+    simulation_advance(scene->sim, now);
+    simulation_get_state(scene->sim, now, &state);
+    Vec3 eye = state.camera_position;
+    float x_rot = state.x_rot, y_rot = state.y_rot;
+    if(scene->camera_path)
+    {
+        // the path owns the camera, warmup frames hold the first key
+        CameraKey key;
+        camera_path_sample(scene->camera_path, (float) ((int) packet->frame - BENCHMARK_WARMUP_FRAMES), &key);
+        eye = key.position;
+        x_rot = key.x_rot;
+        y_rot = key.y_rot;
+    }
+
+    memcpy(packet->projection, scene->projection, sizeof(packet->projection));
+    float view[MATRIX_SIZE] = {
+        1.0f, 0.0f, 0.0f, -eye.x,
+        0.0f, 1.0f, 0.0f, -eye.y,
+        0.0f, 0.0f, 1.0f, -eye.z,
+        0.0f, 0.0f, 0.0f, 1.0f};
+    memcpy(packet->view, view, sizeof(view));
+
+    TransformList model = {0};
+    rotate_ccw_y(&model, x_rot);
+    rotate_ccw_x(&model, y_rot);
+    float m[MATRIX_SIZE];
+    transform_list_compose(&model, m);
+    // view space z of the object's origin, keys sort front to back
+    uint32_t depth = command_depth(m[11] - eye.z, scene->far);
+    if(!command_buffer_push(&packet->commands, command_key(PASS_OPAQUE, SHADER_GLOBE, TEXTURE_EARTH, MESH_EARTH, depth), m, sizeof(m)))
+        return;
+
+    // the feedback pass works in model space, model is a pure rotation so its inverse is its transpose
+    packet->vt_view = (VirtualTextureView) {
+        .eye = (Vec3) {
+            m[0] * eye.x + m[4] * eye.y + m[8] * eye.z,
+            m[1] * eye.x + m[5] * eye.y + m[9] * eye.z,
+            m[2] * eye.x + m[6] * eye.y + m[10] * eye.z,
+        },
+        .pixel_angle = 2.0f * tanf(FOV/2) / WINDOW_HEIGHT,
+    };
+
+    float spin = state.spin;
+    for(int i = 1; i < scene->object_count; ++i)
+    {
+        // fibonacci sphere, evenly spread without any tables
+        float y = 1.0f - 2.0f * (i - 0.5f) / (scene->object_count - 1);
+        float ring = sqrtf(1.0f - y * y);
+        float angle = i * 2.39996323f + spin * 0.1f;
+        transform_list_clear(&model);
+        rotate_ccw_y(&model, x_rot);
+        rotate_ccw_x(&model, y_rot);
+        translate(&model, MOON_SHELL_RADIUS * ring * cosf(angle), MOON_SHELL_RADIUS * y, MOON_SHELL_RADIUS * ring * sinf(angle));
+        scale(&model, MOON_SCALE, MOON_SCALE, MOON_SCALE);
+        rotate_ccw_y(&model, spin + i);
+        transform_list_compose(&model, m);
+        depth = command_depth(m[11] - eye.z, scene->far);
+        if(!command_buffer_push(&packet->commands, command_key(PASS_OPAQUE, SHADER_GLOBE, TEXTURE_EARTH, MESH_MOON, depth), m, sizeof(m)))
+            return;
+    }
+}
+
+static void parse_args(int argc, char** argv, Options* options)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--virtual-texture") == 0)
+        {
+            options->virtual_texture = true;
+        }
+        else if(strcmp(argv[i], "--headless") == 0)
+        {
+            options->headless = true;
+        }
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            options->frame_limit = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+        {
+            options->dump_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            options->profile_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+        {
+            options->benchmark_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+        {
+            options->camera_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+        {
+            options->fps = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--vsync") == 0)
+        {
+            options->vsync = true;
+        }
+        else if(strcmp(argv[i], "--late-input") == 0)
+        {
+            options->late_input = true;
+        }
+        else if(strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+        {
+            options->sim_hz = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--sim-thread") == 0)
+        {
+            options->sim_thread = true;
+        }
+        else if(strcmp(argv[i], "--pipeline") == 0)
+        {
+            options->pipeline = true;
+        }
+        else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            options->record_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            options->replay_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--packed") == 0 && i + 1 < argc)
+        {
+            options->pack_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--cubemap") == 0)
+        {
+            options->cube_map = true;
+        }
+        else if(strcmp(argv[i], "--watch") == 0)
+        {
+            options->watch = true;
+        }
+        else if(strcmp(argv[i], "--objects") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            options->object_count = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("usage: %s [--virtual-texture | --packed earth.pack | --cubemap] [--headless] [--frames N] [--dump frame.png|frame_%%04d.png (or .ppm)] [--profile trace.json]\n       [--benchmark results.json [--camera-path path.txt]]\n       [--fps N (0 unlimited)] [--vsync] [--late-input]\n       [--sim-hz N] [--sim-thread] [--pipeline] [--objects N]\n       [--record input.log | --replay input.log] [--watch]\n", argv[0]);
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t launch_ns = time_now_ns();
+    Options options = {.fps = FPS, .sim_hz = SIMULATION_DEFAULT_HZ, .object_count = 1};
+    parse_args(argc, argv, &options);
+
+    InputLog input_log = {0};
+    if(options.replay_path)
+    {
+        if(!input_log_open(&input_log, options.replay_path))
+            return -1;
+        if(!options.frame_limit)
+            options.frame_limit = input_log.header.frame_count;
+    }
+    if(options.record_path || options.replay_path)
+    {
+        // both ends have to step the same way for the replay to reproduce the recording
+        if(options.sim_thread || options.pipeline)
+            printf("warning: --sim-thread and --pipeline sample input on another thread, replays will not be exact\n");
+    }
+
+    CameraPath camera_path = {0};
+    Benchmark benchmark = {0};
+    if(options.benchmark_path)
+    {
+        if(options.camera_path)
+        {
+            if(!camera_path_load(&camera_path, options.camera_path))
+                return -1;
+        }
+        else
+        {
+            camera_path_default(&camera_path);
+        }
+        if(!options.frame_limit)
+            options.frame_limit = BENCHMARK_WARMUP_FRAMES + camera_path_length(&camera_path);
+        benchmark_init(&benchmark, BENCHMARK_WARMUP_FRAMES);
+    }
+    if(options.headless && !options.frame_limit)
+        options.frame_limit = HEADLESS_DEFAULT_FRAMES;
+    // nothing to pace against without a display, benchmarks run flat out
+    if(options.headless || options.benchmark_path)
+    {
+        options.fps = 0.0;
+        options.vsync = false;
+    }
+
+    if(options.headless)
+        render_window_init_headless(&window, WINDOW_WIDTH, WINDOW_HEIGHT, options.frame_limit);
+    else
+        render_window_init(&window, WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGl");
+    uint64_t context_ready_ns = time_now_ns();
+    window.frame_limit = options.frame_limit;
+    window.dump_path = options.dump_path;
+    if(options.profile_path || options.benchmark_path)
+    {
+        profiler_init(true);
+        profiler_set_thread_name("main");
+    }
+    render_window_set_swap_interval(&window, options.vsync ? 1 : 0);
+    FrameScheduler scheduler;
+    frame_scheduler_init(&scheduler, options.fps, options.vsync ? 1 : 0, render_window_get_refresh_rate(&window), options.late_input);
+    InputMap* input_map = &window.input_map;
+    input_map_bind_key(input_map, GLFW_KEY_ESCAPE, ACTION_QUIT);
+    input_map_bind_key(input_map, GLFW_KEY_W, ACTION_MOVE_FORWARD);
+    input_map_bind_key(input_map, GLFW_KEY_S, ACTION_MOVE_BACKWARD);
+    input_map_bind_key(input_map, GLFW_KEY_D, ACTION_MOVE_RIGHT);
+    input_map_bind_key(input_map, GLFW_KEY_A, ACTION_MOVE_LEFT);
+    input_map_set_handler(input_map, ACTION_QUIT, quit, &window);
+    uint64_t fixed_frame_ns = 0;
+    if(options.replay_path)
+    {
+        if(input_log.header.width != WINDOW_WIDTH || input_log.header.height != WINDOW_HEIGHT)
+            printf("warning: input log was recorded at %ux%u\n", input_log.header.width, input_log.header.height);
+        fixed_frame_ns = input_log.header.frame_ns;
+        input_map->cursor_x = input_log.header.cursor_x;
+        input_map->cursor_y = input_log.header.cursor_y;
+        window.input_log = &input_log;
+    }
+    else if(options.record_path)
+    {
+        fixed_frame_ns = (uint64_t) (1e9 / (options.fps > 0.0 ? options.fps : FPS));
+        if(!input_log_create(&input_log, options.record_path, WINDOW_WIDTH, WINDOW_HEIGHT, fixed_frame_ns, input_map->cursor_x, input_map->cursor_y))
+            return -1;
+        input_map->cursor_x = input_log.header.cursor_x;
+        input_map->cursor_y = input_log.header.cursor_y;
+        window.input_log = &input_log;
+    }
+    
+    MeshCache earth = {0};
+    profiler_begin("load mesh");
+    if(!mesh_cache_get_earth(&earth, EARTH_SECTORS, EARTH_STACKS))
+    {
+        printf("Failed to load earth mesh");
+        return -1;
+    }
+    profiler_end();
+
+    // hot reload watches the files, so it has to read them too
+    if(options.watch)
+        asset_prefer_disk(true);
+    ShaderText vertex_text, fragment_text;
+    if(!shader_preprocess("vertex.glsl", &vertex_text) || !shader_preprocess("fragment.glsl", &fragment_text))
+        exit(0);
+
+    // the variant covers exactly the texture this run uses, the fallback only needs vertex colours
+    ShaderPermutation globe_permutation = {.model_count = 1, .texture_format = SHADER_TEXTURE_PLAIN};
+    if(options.virtual_texture)
+        globe_permutation.texture_format = SHADER_TEXTURE_VIRTUAL;
+    else if(options.pack_path)
+        globe_permutation.texture_format = SHADER_TEXTURE_PACKED;
+    else if(options.cube_map)
+        globe_permutation.texture_format = SHADER_TEXTURE_CUBE;
+    ShaderPermutation fallback_permutation = {.model_count = 1, .use_color = true, .texture_format = SHADER_TEXTURE_NONE};
+    ShaderVariant globe_variant, fallback_variant;
+    shader_variant_init(&globe_variant, "globe", &globe_permutation, &vertex_text, &fragment_text);
+    shader_variant_init(&fallback_variant, "globe", &fallback_permutation, &vertex_text, &fragment_text);
+
+    // the globe program goes first so the driver compiles it while the fallback is built
+    bool parallel_compile = program_cache_init();
+    ProgramBuild globe_build;
+    profiler_begin("submit program");
+    if(!program_cache_submit(&globe_build, &globe_variant.source))
+    {
+        printf("Failed to build shader program\n");
+        exit(0);
+    }
+    profiler_end();
+
+    unsigned int fallbackProgram;
+    ProgramCacheStats fallback_stats;
+    profiler_begin("load fallback program");
+    if(!program_cache_load(&fallback_variant.source, &fallbackProgram, &fallback_stats))
+    {
+        printf("Failed to build fallback shader program\n");
+        exit(0);
+    }
+    profiler_end();
+    HotReload reload = {.permutation = globe_permutation};
+    if(options.watch)
+    {
+        if(!asset_watch_init(&reload.watch))
+            return -1;
+        hot_reload_watch_shaders(&reload, &vertex_text);
+        hot_reload_watch_shaders(&reload, &fragment_text);
+    }
+    shader_text_free(&vertex_text);
+    shader_text_free(&fragment_text);
+    // dumps and replays are compared against golden images, they must not see the fallback
+    if(options.dump_path || options.replay_path)
+        program_cache_wait(&globe_build);
 
     unsigned int VBO, VAO, EBO;
     glGenVertexArrays(1, &VAO);
@@ -148,23 +875,29 @@ int main()
 
     glBindVertexArray(VAO);
 
+    // upload straight from the mapped cache file
+    const MeshHeader* earth_header = earth.header;
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vbuff.size, &vbuff, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) earth_header->vertex_count * earth_header->vertex_stride, earth.vertices, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ibuff.buffer), ibuff.buffer, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) earth_header->index_count * earth_header->index_type, earth.indices, GL_STATIC_DRAW);
 
-    //pos
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)0);
-    glEnableVertexAttribArray(0);
-
-    //color
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 3));
-    glEnableVertexAttribArray(1);
-
-    //text
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 6));
-    glEnableVertexAttribArray(2);
+    //pos, color, text
+    for(unsigned int i = 0; i < earth_header->attrib_count; ++i)
+    {
+        const MeshAttrib* attrib = &earth_header->attribs[i];
+        assert(attrib->type == MESH_ATTRIB_FLOAT32);
+        glVertexAttribPointer(attrib->location, attrib->components, GL_FLOAT, GL_FALSE, earth_header->vertex_stride, (void*)(uintptr_t) attrib->offset);
+        glEnableVertexAttribArray(attrib->location);
+    }
+    GLenum earth_index_type = earth_header->index_type == MESH_INDEX_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    MeshLod earth_lod = earth_header->lods[0];
+    MeshLod moon_lod = earth_header->lods[MOON_LOD < earth_header->lod_count ? MOON_LOD : earth_header->lod_count - 1];
+    // index_type doubles as the index size in bytes
+    void* earth_lod_offset = (void*)(uintptr_t) (earth_lod.index_offset * earth_header->index_type);
+    void* moon_lod_offset = (void*)(uintptr_t) (moon_lod.index_offset * earth_header->index_type);
+    mesh_cache_close(&earth);
     /* glPolygonMode( GL_FRONT_AND_BACK, GL_LINE ); */
     glEnable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
@@ -172,115 +905,283 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, 0); 
     glBindVertexArray(0);
   
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("earth00.jpg", &width, &height, &nrChannels, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    if(data)
+    unsigned int texture = 0;
+    VirtualTexture earth_vt = {0};
+    PackManifest pack = {0};
+    TextureStream earth_stream = {0};
+    profiler_begin("load texture");
+    if(options.virtual_texture)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if(!virtual_texture_open(&earth_vt, EARTH_TEXTURE))
+        {
+            printf("Failed to load virtual texture");
+            return -1;
+        }
+    }
+    else if(options.pack_path)
+    {
+        if(!pack_manifest_load(&pack, options.pack_path) || !(texture = load_packed_texture(&pack)))
+        {
+            printf("Failed to load packed texture %s\n", options.pack_path);
+            return -1;
+        }
+    }
+    else if(options.cube_map)
+    {
+        if(!pack_manifest_load(&pack, EARTH_PACK) || !(texture = load_cube_texture(&pack)))
+        {
+            printf("Failed to load cube map %s\n", EARTH_PACK);
+            return -1;
+        }
     }
     else
     {
-        printf("Failed to load texture");
+        if(!texture_stream_open(&earth_stream, EARTH_TEXTURE))
+            return -1;
+        texture = earth_stream.texture;
+        // dumps and replays are compared against golden images, they must not see the proxy
+        if((options.dump_path || options.replay_path) && !texture_stream_finish(&earth_stream))
+            return -1;
     }
-    stbi_image_free(data);
+    profiler_end();
 
-    struct timeval start_time = {0};
-    struct timeval end_time = {0};
 
-    TransformList model = {0};
-    TransformList view = {0};
-    TransformList projection = {0};
-    
     float near = 0.0f;
     float far = 10.0f;
     float diff = near - far;
     double prev_mouse_x = WINDOW_WIDTH/2;
     double prev_mouse_y = WINDOW_HEIGHT/2;
     double curr_mouse_x, curr_mouse_y;
-    float x_rot, y_rot = 0.0f;
-    float x_total_rot, y_total_rot = 0.0f;
     float rotation_sensitivity = 0.5f;
-    /* https://ogldev.org/www/tutorial12/tutorial12.html */
-    transform_list_push(&projection, (float[16]) {
+    Simulation sim;
+    SimState sim_state = {.camera_position = camera.position};
+    simulation_init(&sim, options.sim_hz, &sim_state, options.sim_thread);
+
+    Scene scene = {
+        .sim = &sim,
+        .camera_path = options.benchmark_path ? &camera_path : NULL,
+        .object_count = options.object_count,
+        .start_ns = sim.last_ns,
+        .fixed_frame_ns = fixed_frame_ns,
+        .far = far,
+        /* https://ogldev.org/www/tutorial12/tutorial12.html */
+        .projection = {
             (1/tanf(FOV/2))/ASPECT_RATIO, 0.0f, 0.0f, 0.0f,
             0.0f, 1/tanf(FOV/2), 0.0f, 0.0f,
             0.0f, 0.0f, (-far - near)/diff, 2.0f * far * near / diff,
-            0.0f, 0.0f, 1.0f, 0.0f}
-        );
+            0.0f, 0.0f, 1.0f, 0.0f},
+    };
+    RenderPipeline pipeline;
+    render_pipeline_init(&pipeline, build_frame, &scene, options.pipeline);
+
+    GlBackend gl = {
+        .virtual_texture = options.virtual_texture ? &earth_vt : NULL,
+        .pack = options.pack_path && !options.virtual_texture ? &pack : NULL,
+        .cube_map = options.cube_map && !options.virtual_texture && !options.pack_path,
+        .shaders[SHADER_GLOBE] = gl_shader(globe_build.state == PROGRAM_BUILD_READY ? globe_build.program : fallbackProgram),
+        .textures[TEXTURE_EARTH] = texture,
+        .meshes[MESH_EARTH] = {VAO, EBO, earth_lod.index_count, earth_index_type, earth_lod_offset},
+        .meshes[MESH_MOON] = {VAO, EBO, moon_lod.index_count, earth_index_type, moon_lod_offset},
+    };
+    if(gl.pack)
+        texture_pack_tile_masks(gl.pack, gl.pack_masks);
+    if(options.watch)
+        hot_reload_watch_textures(&reload, &options, &pack);
+    RenderBackend backend = {
+        .context = &gl,
+        .bind_shader = gl_bind_shader,
+        .bind_texture = gl_bind_texture,
+        .bind_mesh = gl_bind_mesh,
+        .draw = gl_draw,
+    };
+    CommandStats command_stats = {0};
+    uint64_t first_frame_ns = 0;
+    int fallback_frames = 0;
+    // kept apart from the stream, a hot reload replaces it
+    uint64_t texture_resident_ns = earth_stream.resident_ns;
 
     while (!render_window_should_close(&window))
     {
-        gettimeofday(&start_time, NULL);
+        profiler_begin("wait");
+        frame_scheduler_wait(&scheduler);
+        profiler_end();
+        uint64_t frame_start_ns = time_now_ns();
+        profiler_begin("frame");
+        profiler_begin("input");
         render_window_process_input(&window);
-        glClearColor(0.0f, 0.6f, 0.4f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        transform_list_clear(&model);
-        transform_list_clear(&view);
-        x_rot = 0.0f;
-        y_rot = 0.0f;
-        
+        SimInput sim_input = {.move = move_direction(input_map)};
         render_window_get_mouse_pos(&window, &curr_mouse_x, &curr_mouse_y);
-
         if(render_window_get_mouse_dragging(&window)) {
-            x_rot = rotation_sensitivity * (float) ((curr_mouse_x - prev_mouse_x) / WINDOW_WIDTH);
-            y_rot = rotation_sensitivity * (float) ((curr_mouse_y - prev_mouse_y) / WINDOW_HEIGHT);
+            sim_input.drag_x = rotation_sensitivity * (float) ((curr_mouse_x - prev_mouse_x) / WINDOW_WIDTH);
+            sim_input.drag_y = rotation_sensitivity * (float) ((curr_mouse_y - prev_mouse_y) / WINDOW_HEIGHT);
         }
-        x_total_rot += x_rot;
-        y_total_rot += y_rot;
-        rotate_ccw_y(&model, x_total_rot);
-        rotate_ccw_x(&model, y_total_rot);
+        prev_mouse_x = curr_mouse_x;
+        prev_mouse_y = curr_mouse_y;
+        simulation_set_input(&sim, &sim_input);
+        profiler_end();
 
-        transform_list_push(&view, (float[16]) {
-                1.0f,0.0f,0.0f, -camera.position.x,
-                0.0f,1.0f,0.0f, -camera.position.y,
-                0.0f,0.0f,1.0f,-camera.position.z,
-                0.0f, 0.0f, 0.0f, 1.0f});
+        // threaded this only waits for the worker, which built it during the last frame
+        profiler_begin("acquire frame");
+        const FramePacket* packet = render_pipeline_acquire(&pipeline);
+        profiler_end();
 
-            prev_mouse_x = curr_mouse_x;
-            prev_mouse_y = curr_mouse_y;
-        
-            
-        glUseProgram(shaderProgram);
-        unsigned int model_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(model_loc, model.size, GL_TRUE, (float*) model.transformations[0]);
-        unsigned int count_loc = glGetUniformLocation(shaderProgram, "model_count");
-        glUniform1i(count_loc, model.size);
+        profiler_gpu_begin("clear");
+        glClearColor(0.0f, 0.6f, 0.4f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        profiler_gpu_end();
 
-        unsigned int view_loc = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(view_loc, view.size, GL_TRUE, (float*) view.transformations[0]);
+        if(options.virtual_texture)
+        {
+            profiler_begin("virtual texture");
+            virtual_texture_update(&earth_vt, &packet->vt_view);
+            profiler_end();
+        }
+        else if(earth_stream.texture && earth_stream.state != TEXTURE_STREAM_RESIDENT)
+        {
+            profiler_begin("stream texture");
+            texture_stream_update(&earth_stream, TEXTURE_STREAM_FRAME_BUDGET);
+            if(!texture_resident_ns)
+                texture_resident_ns = earth_stream.resident_ns;
+            profiler_end();
+        }
 
-        unsigned int projection_loc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(projection_loc, projection.size, GL_TRUE, (float*) projection.transformations[0]);
+        // swapped between frames, the command buffer only holds the shader id
+        if(globe_build.state == PROGRAM_BUILD_PENDING)
+        {
+            profiler_begin("poll program");
+            if(program_cache_poll(&globe_build) && globe_build.state == PROGRAM_BUILD_READY)
+                gl.shaders[SHADER_GLOBE] = gl_shader(globe_build.program);
+            profiler_end();
+        }
+        if(options.watch)
+        {
+            profiler_begin("hot reload");
+            hot_reload_update(&reload, &options, &globe_build, &gl, fallbackProgram, &pack, &earth_stream, &texture);
+            profiler_end();
+        }
+        if(gl.shaders[SHADER_GLOBE].program == fallbackProgram)
+            fallback_frames++;
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        profiler_begin("draw");
+        profiler_gpu_begin("draw objects");
+        gl.packet = packet;
+        command_buffer_execute(&packet->commands, &backend, &command_stats);
+        profiler_gpu_end();
+        profiler_end();
+        render_pipeline_release(&pipeline);
 
-        glDrawElements(GL_TRIANGLES, ibuff.size, GL_UNSIGNED_INT, 0);
-             
+        profiler_begin("swap");
+        frame_scheduler_submitted(&scheduler);
+        render_window_swap(&window);
+        frame_scheduler_presented(&scheduler);
+        input_presented(input_map, time_now_ns());
+        if(!first_frame_ns)
+            first_frame_ns = time_now_ns();
+        profiler_end();
+        if(options.benchmark_path)
+            benchmark_add_frame(&benchmark, time_now_ns() - frame_start_ns);
+        profiler_end();
+        profiler_frame_end();
+    }
 
-        glfwSwapBuffers(window.window);
-        glfwPollEvents();
-        gettimeofday(&end_time, NULL);
-        long ellapsed_time_us = (end_time.tv_sec - start_time.tv_sec) * 1000000 + (end_time.tv_usec - start_time.tv_usec);
-        /* printf("ellapsed time in us = %ld\n", ellapsed_time_us); */
-        if(ellapsed_time_us < US_PER_FRAME)
-        {
-            usleep(US_PER_FRAME - ellapsed_time_us);
-        }
+    render_pipeline_shutdown(&pipeline);
+    if(pipeline.threaded)
+    {
+        printf("render pipeline: worker waited %.1fms for free packets, GL thread waited %.1fms for built ones\n",
+               pipeline.build_wait_ns / 1e6, pipeline.submit_wait_ns / 1e6);
+    }
+    simulation_shutdown(&sim);
+    printf("simulation: %lu steps at %.0f Hz%s over %d frames\n", (unsigned long) sim.steps, options.sim_hz,
+           sim.threaded ? " on its own thread" : "", window.frame);
+    frame_scheduler_print_stats(&scheduler);
+    input_print_stats(input_map, window.input_queue.dropped);
+    if(options.record_path)
+    {
+        uint32_t events = input_log.header.event_count, frames = input_log.header.frame_count;
+        if(input_log_close(&input_log))
+            printf("recorded %u input events over %u frames to %s\n", events, frames, options.record_path);
+    }
+    else if(options.replay_path)
+    {
+        printf("replayed %u input events over %u frames\n", input_log.header.event_count, input_log.header.frame_count);
+        input_log_close(&input_log);
+    }
+    if(window.frame > 0)
+    {
+        printf("commands: %.1f draws, %.1f shader, %.1f texture and %.1f mesh binds per frame, %lu redundant binds skipped\n",
+               (double) command_stats.draws / window.frame, (double) command_stats.shader_binds / window.frame,
+               (double) command_stats.texture_binds / window.frame, (double) command_stats.mesh_binds / window.frame,
+               (unsigned long) command_stats.skipped_binds);
+    }
+    const ProgramCacheStats* program_stats = &globe_build.stats;
+    printf("program %s cache %s: submit %.1fms", globe_variant.name,
+           program_stats->hit ? "hit" : "miss", program_stats->submit_ns / 1e6);
+    if(globe_build.state != PROGRAM_BUILD_PENDING)
+        printf(", %s after %.1fms", globe_build.state == PROGRAM_BUILD_READY ? "linked" : "failed", program_stats->ns / 1e6);
+    if(program_stats->binary_size)
+        printf(", %zu byte binary%s", program_stats->binary_size, program_stats->stored ? " stored" : "");
+    printf(", %s, %d frames drawn with the fallback\n", parallel_compile ? "parallel compile" : "blocking compile", fallback_frames);
+    AssetStats asset_stats;
+    asset_get_stats(&asset_stats);
+    printf("assets: %d embedded, %d read from disk, %.2fms\n", asset_stats.embedded_loads, asset_stats.disk_loads, asset_stats.ns / 1e6);
+    if(first_frame_ns)
+    {
+        printf("startup: context ready after %.1fms (GL loaded in %.2fms), first frame after %.1fms",
+               (context_ready_ns - launch_ns) / 1e6, window.gl_load_ns / 1e6, (first_frame_ns - launch_ns) / 1e6);
+        if(texture_resident_ns)
+            printf(", full resolution texture after %.1fms", (texture_resident_ns - launch_ns) / 1e6);
+        printf("\n");
+    }
+    if(options.benchmark_path)
+    {
+        benchmark_add_timing(&benchmark, "time_to_context", context_ready_ns - launch_ns);
+        benchmark_add_timing(&benchmark, "gl_load", window.gl_load_ns);
+        if(first_frame_ns)
+            benchmark_add_timing(&benchmark, "time_to_first_frame", first_frame_ns - launch_ns);
+        if(texture_resident_ns)
+            benchmark_add_timing(&benchmark, "time_to_full_texture", texture_resident_ns - launch_ns);
+        benchmark_add_timing(&benchmark, "program_submit", program_stats->submit_ns);
+        benchmark_add_timing(&benchmark, program_stats->hit ? "program_load_warm" : "program_load_cold", program_stats->ns);
+        benchmark_report(&benchmark, options.benchmark_path, (const char*) glGetString(GL_RENDERER), WINDOW_WIDTH, WINDOW_HEIGHT);
+        benchmark_free(&benchmark);
+        camera_path_free(&camera_path);
+    }
+    if(options.profile_path)
+    {
+        profiler_print_summary();
+        if(profiler_write_chrome_trace(options.profile_path))
+            printf("wrote trace to %s\n", options.profile_path);
     }
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
-    glfwTerminate();
+    glDeleteBuffers(1, &EBO);
+    if(options.virtual_texture)
+    {
+        virtual_texture_print_stats(&earth_vt);
+        virtual_texture_close(&earth_vt);
+    }
+    if(options.watch)
+    {
+        printf("hot reload: %d assets reloaded\n", reload.reloads);
+        asset_watch_shutdown(&reload.watch);
+        if(reload.stream.texture)
+            texture_stream_close(&reload.stream);
+        if(reload.program.state == PROGRAM_BUILD_PENDING)
+            glDeleteProgram(reload.program.program);
+    }
+    if(earth_stream.texture)
+        texture_stream_close(&earth_stream);
+    else
+        glDeleteTextures(1, &texture);
+    // the startup program may have been replaced by a reload, only the bound one is live
+    if(gl.shaders[SHADER_GLOBE].program != fallbackProgram)
+        glDeleteProgram(gl.shaders[SHADER_GLOBE].program);
+    if(globe_build.state == PROGRAM_BUILD_PENDING)
+        glDeleteProgram(globe_build.program);
+    glDeleteProgram(fallbackProgram);
+    profiler_shutdown();
+    render_window_terminate(&window);
     
     return 0;
 }
@@ -0,0 +1,213 @@
+#include <assert.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "mesh_cache.h"
+
+#define EARTH_MIN_LOD_QUADS 4
+
+/* FNV-1a over the generator name and its parameters. */
+uint64_t mesh_cache_key(const char* generator, const int* params, int param_count)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char* c = generator; *c; ++c)
+    {
+        hash ^= (unsigned char) *c;
+        hash *= 0x100000001b3ull;
+    }
+    const unsigned char* bytes = (const unsigned char*) params;
+    for (size_t i = 0; i < sizeof(int) * param_count; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    hash ^= MESH_CACHE_VERSION;
+    return hash;
+}
+
+static uint64_t align_up(uint64_t offset)
+{
+    return (offset + MESH_CACHE_ALIGN - 1) & ~(uint64_t) (MESH_CACHE_ALIGN - 1);
+}
+
+static bool write_padding(FILE* file, uint64_t from, uint64_t to)
+{
+    static const char zeros[MESH_CACHE_ALIGN] = {0};
+    return fwrite(zeros, 1, to - from, file) == to - from;
+}
+
+static void compute_bounds(const Vertex_Buffer* vbuff, MeshHeader* header)
+{
+    Vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+    Vec3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t i = 0; i < vbuff->size; ++i)
+    {
+        Vec3 p = vbuff->buffer[i].pos;
+        min = (Vec3) {fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+        max = (Vec3) {fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+    }
+    memcpy(header->bounds_min, &min, sizeof(header->bounds_min));
+    memcpy(header->bounds_max, &max, sizeof(header->bounds_max));
+}
+
+static bool write_indices(FILE* file, const Index_Buffer* ibuff, MeshIndexType type)
+{
+    if (type == MESH_INDEX_U32)
+        return fwrite(ibuff->buffer, sizeof(uint32_t), ibuff->size, file) == ibuff->size;
+
+    uint16_t chunk[4096];
+    size_t written = 0;
+    while (written < ibuff->size)
+    {
+        size_t count = ibuff->size - written;
+        if (count > sizeof(chunk) / sizeof(chunk[0]))
+            count = sizeof(chunk) / sizeof(chunk[0]);
+        for (size_t i = 0; i < count; ++i)
+            chunk[i] = (uint16_t) ibuff->buffer[written + i];
+        if (fwrite(chunk, sizeof(uint16_t), count, file) != count)
+            return false;
+        written += count;
+    }
+    return true;
+}
+
+bool mesh_cache_write(const char* path, uint64_t key, const Vertex_Buffer* vbuff, const Index_Buffer* ibuff,
+                      const MeshLod* lods, int lod_count)
+{
+    assert(lod_count > 0 && lod_count <= MESH_CACHE_MAX_LODS);
+
+    MeshHeader header = {
+        .magic = MESH_CACHE_MAGIC,
+        .version = MESH_CACHE_VERSION,
+        .key = key,
+        .vertex_count = vbuff->size,
+        .vertex_stride = sizeof(Vertex),
+        .index_count = ibuff->size,
+        .index_type = vbuff->size <= UINT16_MAX ? MESH_INDEX_U16 : MESH_INDEX_U32,
+        .attrib_count = 3,
+        .lod_count = lod_count,
+        .attribs = {
+            {.location = 0, .components = 3, .type = MESH_ATTRIB_FLOAT32, .offset = offsetof(Vertex, pos)},
+            {.location = 1, .components = 3, .type = MESH_ATTRIB_FLOAT32, .offset = offsetof(Vertex, col)},
+            {.location = 2, .components = 2, .type = MESH_ATTRIB_FLOAT32, .offset = offsetof(Vertex, tex)},
+        },
+    };
+    memcpy(header.lods, lods, sizeof(MeshLod) * lod_count);
+    compute_bounds(vbuff, &header);
+
+    uint64_t vertex_bytes = (uint64_t) header.vertex_count * header.vertex_stride;
+    header.vertex_data_offset = align_up(sizeof(MeshHeader));
+    header.index_data_offset = align_up(header.vertex_data_offset + vertex_bytes);
+
+    /* Write next to the target and rename so a crash never leaves a
+     * truncated file under the real name. */
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* file;
+    if ((file = fopen(tmp_path, "wb")) == NULL)
+    {
+        perror("Error writing mesh cache");
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && write_padding(file, sizeof(header), header.vertex_data_offset)
+        && fwrite(vbuff->buffer, header.vertex_stride, header.vertex_count, file) == header.vertex_count
+        && write_padding(file, header.vertex_data_offset + vertex_bytes, header.index_data_offset)
+        && write_indices(file, ibuff, header.index_type);
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        perror("Error writing mesh cache");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+bool mesh_cache_open(const char* path, uint64_t key, MeshCache* cache)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    if (!map_file(path, &cache->file, FILE_ACCESS_WILLNEED))
+        return false;
+
+    const MeshHeader* header = (const MeshHeader*) cache->file.data;
+    size_t size = cache->file.size;
+    if (size < sizeof(MeshHeader)
+        || header->magic != MESH_CACHE_MAGIC
+        || header->version != MESH_CACHE_VERSION
+        || header->key != key
+        || (header->index_type != MESH_INDEX_U16 && header->index_type != MESH_INDEX_U32)
+        || header->attrib_count > MESH_CACHE_MAX_ATTRIBS
+        || header->lod_count == 0
+        || header->lod_count > MESH_CACHE_MAX_LODS
+        || header->vertex_data_offset + (uint64_t) header->vertex_count * header->vertex_stride > size
+        || header->index_data_offset + (uint64_t) header->index_count * header->index_type > size)
+    {
+        fprintf(stderr, "Ignoring stale mesh cache %s\n", path);
+        unmap_file(&cache->file);
+        return false;
+    }
+
+    cache->header = header;
+    cache->vertices = cache->file.data + header->vertex_data_offset;
+    cache->indices = cache->file.data + header->index_data_offset;
+    return true;
+}
+
+void mesh_cache_close(MeshCache* cache)
+{
+    unmap_file(&cache->file);
+    *cache = (MeshCache) {0};
+}
+
+/* Opens the cached earth mesh for the given resolution, generating and
+ * writing it first on a miss. LOD n skips 2^n rows and columns of the full
+ * grid for as long as the grid divides evenly. */
+bool mesh_cache_get_earth(MeshCache* cache, int sectors, int stacks)
+{
+    int params[] = {sectors, stacks};
+    uint64_t key = mesh_cache_key("earth", params, 2);
+    char path[256];
+    snprintf(path, sizeof(path), MESH_CACHE_DIR "/earth_%dx%d.mesh", sectors, stacks);
+
+    if (mesh_cache_open(path, key, cache))
+        return true;
+
+    if (mkdir(MESH_CACHE_DIR, 0755) != 0 && errno != EEXIST)
+    {
+        perror("Error creating mesh cache directory");
+        return false;
+    }
+
+    Vertex_Buffer vbuff = {0};
+    Index_Buffer ibuff = {0};
+    MeshLod lods[MESH_CACHE_MAX_LODS];
+    int lod_count = 0;
+    make_earth_geom(&vbuff, &ibuff, sectors, stacks);
+    lods[lod_count++] = (MeshLod) {.index_offset = 0, .index_count = ibuff.size};
+    for (int step = 2; lod_count < MESH_CACHE_MAX_LODS; step *= 2)
+    {
+        if ((sectors/2) % step || (stacks/2) % step
+            || sectors/2/step < EARTH_MIN_LOD_QUADS || stacks/2/step < EARTH_MIN_LOD_QUADS)
+            break;
+        uint32_t offset = ibuff.size;
+        uint32_t count = make_earth_lod_indices(&ibuff, sectors, stacks, step);
+        lods[lod_count++] = (MeshLod) {.index_offset = offset, .index_count = count};
+    }
+
+    bool ok = mesh_cache_write(path, key, &vbuff, &ibuff, lods, lod_count);
+    free_vb(&vbuff);
+    free_ib(&ibuff);
+    return ok && mesh_cache_open(path, key, cache);
+}
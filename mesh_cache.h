@@ -0,0 +1,81 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "geom.h"
+#include "util.h"
+
+#define MESH_CACHE_MAGIC 0x4853454d // "MESH"
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_DIR "cache"
+#define MESH_CACHE_ALIGN 64
+#define MESH_CACHE_MAX_ATTRIBS 8
+#define MESH_CACHE_MAX_LODS 8
+
+typedef enum MeshAttribType
+{
+    MESH_ATTRIB_FLOAT32 = 1,
+}MeshAttribType;
+
+typedef enum MeshIndexType
+{
+    MESH_INDEX_U16 = 2,
+    MESH_INDEX_U32 = 4,
+}MeshIndexType;
+
+typedef struct MeshAttrib
+{
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;   // MeshAttribType
+    uint32_t offset; // bytes from start of vertex
+}MeshAttrib;
+
+/* A range of the shared index buffer, all LODs index the same vertices. */
+typedef struct MeshLod
+{
+    uint32_t index_offset; // in indices, not bytes
+    uint32_t index_count;
+}MeshLod;
+
+/* On-disk layout, written as-is in native byte order. Vertex and index data
+ * follow at the given offsets, each aligned to MESH_CACHE_ALIGN so they can
+ * be handed to glBufferData straight out of the mapping. */
+typedef struct MeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint32_t index_count;
+    uint32_t index_type; // MeshIndexType
+    uint32_t attrib_count;
+    uint32_t lod_count;
+    MeshAttrib attribs[MESH_CACHE_MAX_ATTRIBS];
+    MeshLod lods[MESH_CACHE_MAX_LODS];
+    float bounds_min[3];
+    float bounds_max[3];
+    uint64_t vertex_data_offset;
+    uint64_t index_data_offset;
+}MeshHeader;
+
+typedef struct MeshCache
+{
+    FileSpan file;
+    const MeshHeader* header;
+    const void* vertices;
+    const void* indices;
+}MeshCache;
+
+uint64_t mesh_cache_key(const char* generator, const int* params, int param_count);
+bool mesh_cache_write(const char* path, uint64_t key, const Vertex_Buffer* vbuff, const Index_Buffer* ibuff,
+                      const MeshLod* lods, int lod_count);
+bool mesh_cache_open(const char* path, uint64_t key, MeshCache* cache);
+void mesh_cache_close(MeshCache* cache);
+
+bool mesh_cache_get_earth(MeshCache* cache, int sectors, int stacks);
+
+#endif // MESH_CACHE_H
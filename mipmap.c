@@ -0,0 +1,492 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mipmap.h"
+
+#define MAX_TAPS 12
+#define WINDOWED_SINC_RADIUS 3.0f // in destination texels
+#define KAISER_ALPHA 4.0f
+#define SRGB_ENCODE_SIZE 4096
+#define MIN_ROWS_PER_THREAD 32
+#define ROW_SLACK 8 // floats past the padded row the 1 channel SIMD loop may read
+
+/* Weights for one output texel of a 2:1 reduction. Output texel i is centred
+ * between source texels 2i and 2i+1 and reads taps 2i+first .. 2i+first+taps-1. */
+typedef struct Kernel
+{
+    int first;
+    int taps;
+    float weights[MAX_TAPS];
+}Kernel;
+
+typedef struct Job
+{
+    const MipLevel* src;
+    MipLevel* dst;
+    int channels;
+    int row_begin;
+    int row_end;
+    const Kernel* kernel;
+    const MipOptions* options;
+}Job;
+
+static float decode_lut[2][256]; // [is_color_srgb][byte]
+static uint8_t srgb_encode_lut[SRGB_ENCODE_SIZE];
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+
+static void init_luts(void)
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        float v = i / 255.0f;
+        decode_lut[0][i] = v;
+        decode_lut[1][i] = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < SRGB_ENCODE_SIZE; ++i)
+    {
+        float v = (float) i / (SRGB_ENCODE_SIZE - 1);
+        float s = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+        srgb_encode_lut[i] = (uint8_t) (s * 255.0f + 0.5f);
+    }
+}
+
+static float sinc(float x)
+{
+    if (fabsf(x) < 1e-6f)
+        return 1.0f;
+    x *= (float) M_PI;
+    return sinf(x) / x;
+}
+
+static float bessel_i0(float x)
+{
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; ++k)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static float filter_weight(MipFilter filter, float x)
+{
+    float a = WINDOWED_SINC_RADIUS;
+    switch (filter)
+    {
+    case MIP_FILTER_KAISER:
+        if (fabsf(x) >= a)
+            return 0.0f;
+        return sinc(x) * bessel_i0(KAISER_ALPHA * sqrtf(1.0f - (x / a) * (x / a))) / bessel_i0(KAISER_ALPHA);
+    case MIP_FILTER_LANCZOS:
+        return fabsf(x) < a ? sinc(x) * sinc(x / a) : 0.0f;
+    case MIP_FILTER_BOX:
+    default:
+        return fabsf(x) <= 0.5f ? 1.0f : 0.0f;
+    }
+}
+
+static void make_kernel(MipFilter filter, Kernel* kernel)
+{
+    int radius = filter == MIP_FILTER_BOX ? 1 : (int) (2 * WINDOWED_SINC_RADIUS);
+    kernel->first = 1 - radius;
+    kernel->taps = 2 * radius;
+    assert(kernel->taps <= MAX_TAPS);
+
+    float sum = 0.0f;
+    for (int t = 0; t < kernel->taps; ++t)
+    {
+        // distance from the output centre in destination texels
+        float x = ((kernel->first + t) - 0.5f) / 2.0f;
+        kernel->weights[t] = filter_weight(filter, x);
+        sum += kernel->weights[t];
+    }
+    for (int t = 0; t < kernel->taps; ++t)
+        kernel->weights[t] /= sum;
+}
+
+static bool is_alpha(int channels, int c)
+{
+    return (channels == 2 && c == 1) || (channels == 4 && c == 3);
+}
+
+static void decode_row(const uint8_t* src, float* dst, int width, int channels, MipColorSpace space)
+{
+    int count = width * channels;
+    if (space == MIP_COLOR_LINEAR)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        // divide rather than multiply by 1/255 so results match decode_lut exactly
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            _mm_storeu_ps(dst + i, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+            _mm_storeu_ps(dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+            _mm_storeu_ps(dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+        }
+#endif
+        for (; i < count; ++i)
+            dst[i] = decode_lut[0][src[i]];
+        return;
+    }
+
+    const float* luts[4];
+    for (int c = 0; c < channels; ++c)
+        luts[c] = decode_lut[!is_alpha(channels, c)];
+    for (int x = 0; x < width; ++x)
+        for (int c = 0; c < channels; ++c)
+            dst[x * channels + c] = luts[c][src[x * channels + c]];
+}
+
+/* Exact integer 2x2 average for the box filter in linear space, the common
+ * case for data maps. Odd edges clamp like the float path. */
+static void box_row_u8(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int src_width, int dst_width, int channels)
+{
+    int x = 0;
+    // texel 2x+1 must exist in the source for the SIMD loop
+    int limit = (src_width / 2 < dst_width ? src_width / 2 : dst_width);
+#ifdef __SSE2__
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i zero = _mm_setzero_si128();
+    if (channels == 4)
+    {
+        for (; x + 4 <= limit; x += 4)
+        {
+            __m128i out[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*) (row0 + (2 * x + 4 * half) * 4));
+                __m128i b = _mm_loadu_si128((const __m128i*) (row1 + (2 * x + 4 * half) * 4));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                out[half] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+            }
+            _mm_storeu_si128((__m128i*) (dst + x * 4), _mm_packus_epi16(out[0], out[1]));
+        }
+    }
+    else if (channels == 1)
+    {
+        const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+        for (; x + 16 <= limit; x += 16)
+        {
+            __m128i out[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*) (row0 + 2 * x + 16 * half));
+                __m128i b = _mm_loadu_si128((const __m128i*) (row1 + 2 * x + 16 * half));
+                __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8)),
+                                            _mm_add_epi16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8)));
+                out[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            }
+            _mm_storeu_si128((__m128i*) (dst + x), _mm_packus_epi16(out[0], out[1]));
+        }
+    }
+#endif
+    for (; x < dst_width; ++x)
+    {
+        int x0 = 2 * x;
+        int x1 = 2 * x + 1 < src_width ? 2 * x + 1 : 2 * x;
+        for (int c = 0; c < channels; ++c)
+        {
+            int sum = row0[x0 * channels + c] + row0[x1 * channels + c] + row1[x0 * channels + c] + row1[x1 * channels + c];
+            dst[x * channels + c] = (uint8_t) ((sum + 2) / 4);
+        }
+    }
+}
+
+static void encode_row(const float* src, uint8_t* dst, int width, int channels, MipColorSpace space)
+{
+    int count = width * channels;
+    int i = 0;
+    if (space == MIP_COLOR_LINEAR)
+    {
+#ifdef __SSE2__
+        const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+        const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 a = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), half), lo), hi);
+            __m128 b = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), half), lo), hi);
+            __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+            _mm_storel_epi64((__m128i*) (dst + i), _mm_packus_epi16(packed, packed));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float v = src[i] * 255.0f + 0.5f;
+            dst[i] = (uint8_t) (v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+        }
+        return;
+    }
+
+    for (int x = 0; x < width; ++x)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            float v = src[x * channels + c];
+            v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+            if (is_alpha(channels, c))
+                dst[x * channels + c] = (uint8_t) (v * 255.0f + 0.5f);
+            else
+                dst[x * channels + c] = srgb_encode_lut[(int) (v * (SRGB_ENCODE_SIZE - 1) + 0.5f)];
+        }
+    }
+}
+
+static void vertical_pass(const float* const* rows, const float* weights, int taps, float* dst, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < taps; ++t)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+        _mm_storeu_ps(dst + i, acc);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        float acc = 0.0f;
+        for (int t = 0; t < taps; ++t)
+            acc += weights[t] * rows[t][i];
+        dst[i] = acc;
+    }
+}
+
+/* src is the vertically filtered row with edge texels replicated into the
+ * padding, so index 2i+first+t is always valid. */
+static void horizontal_pass(const float* src, float* dst, int width, int channels, const Kernel* kernel)
+{
+    const float* w = kernel->weights;
+    int i = 0;
+#ifdef __SSE2__
+    if (channels == 4)
+    {
+        for (; i < width; ++i)
+        {
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < kernel->taps; ++t)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[t]), _mm_loadu_ps(src + (2 * i + kernel->first + t) * 4)));
+            _mm_storeu_ps(dst + i * 4, acc);
+        }
+        return;
+    }
+    if (channels == 1)
+    {
+        for (; i + 4 <= width; i += 4)
+        {
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < kernel->taps; ++t)
+            {
+                const float* p = src + 2 * i + kernel->first + t;
+                __m128 even = _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0));
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[t]), even));
+            }
+            _mm_storeu_ps(dst + i, acc);
+        }
+    }
+#endif
+    for (; i < width; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            float acc = 0.0f;
+            for (int t = 0; t < kernel->taps; ++t)
+                acc += w[t] * src[(2 * i + kernel->first + t) * channels + c];
+            dst[i * channels + c] = acc;
+        }
+    }
+}
+
+static void* run_job(void* arg)
+{
+    const Job* job = arg;
+    const MipLevel* src = job->src;
+    MipLevel* dst = job->dst;
+    const Kernel* kernel = job->kernel;
+    int channels = job->channels;
+
+    if (job->options->filter == MIP_FILTER_BOX && job->options->color_space == MIP_COLOR_LINEAR)
+    {
+        for (int y = job->row_begin; y < job->row_end; ++y)
+        {
+            int y1 = 2 * y + 1 < src->height ? 2 * y + 1 : 2 * y;
+            box_row_u8(src->data + (size_t) (2 * y) * src->width * channels,
+                       src->data + (size_t) y1 * src->width * channels,
+                       dst->data + (size_t) y * dst->width * channels, src->width, dst->width, channels);
+        }
+        return NULL;
+    }
+
+    int row_floats = src->width * channels;
+    int pad = -kernel->first > kernel->taps + kernel->first - 1 ? -kernel->first : kernel->taps + kernel->first - 1;
+
+    // ring of decoded source rows, big enough that sliding by two rows never evicts a live one
+    int ring_size = kernel->taps + 2;
+    float* ring = malloc(sizeof(float) * row_floats * ring_size);
+    int* ring_row = malloc(sizeof(int) * ring_size);
+    float* padded = malloc(sizeof(float) * ((src->width + 2 * pad) * channels + ROW_SLACK));
+    float* filtered = malloc(sizeof(float) * dst->width * channels);
+    assert(ring && ring_row && padded && filtered);
+    for (int i = 0; i < ring_size; ++i)
+        ring_row[i] = -1;
+
+    const float* rows[MAX_TAPS];
+    float* centre = padded + pad * channels;
+    for (int y = job->row_begin; y < job->row_end; ++y)
+    {
+        for (int t = 0; t < kernel->taps; ++t)
+        {
+            int sy = 2 * y + kernel->first + t;
+            sy = sy < 0 ? 0 : (sy >= src->height ? src->height - 1 : sy);
+            int slot = sy % ring_size;
+            if (ring_row[slot] != sy)
+            {
+                decode_row(src->data + (size_t) sy * row_floats, ring + (size_t) slot * row_floats,
+                           src->width, channels, job->options->color_space);
+                ring_row[slot] = sy;
+            }
+            rows[t] = ring + (size_t) slot * row_floats;
+        }
+
+        vertical_pass(rows, kernel->weights, kernel->taps, centre, row_floats);
+        for (int p = 1; p <= pad; ++p)
+        {
+            memcpy(centre - p * channels, centre, sizeof(float) * channels);
+            memcpy(centre + (src->width - 1 + p) * channels, centre + (src->width - 1) * channels, sizeof(float) * channels);
+        }
+        memset(centre + (src->width + pad) * channels, 0, sizeof(float) * ROW_SLACK);
+
+        horizontal_pass(centre, filtered, dst->width, channels, kernel);
+        encode_row(filtered, dst->data + (size_t) y * dst->width * channels, dst->width, channels, job->options->color_space);
+    }
+
+    free(ring);
+    free(ring_row);
+    free(padded);
+    free(filtered);
+    return NULL;
+}
+
+static int online_cpus(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+}
+
+/* Splits the output rows of one level into bands, one per thread. Levels
+ * themselves are built in order since each reads the previous one. */
+static void build_level(const MipLevel* src, MipLevel* dst, int channels, const Kernel* kernel, const MipOptions* options)
+{
+    int thread_count = options->thread_count > 0 ? options->thread_count : online_cpus();
+    if (thread_count > dst->height / MIN_ROWS_PER_THREAD)
+        thread_count = dst->height / MIN_ROWS_PER_THREAD;
+    if (thread_count < 1)
+        thread_count = 1;
+
+    Job jobs[thread_count];
+    pthread_t threads[thread_count];
+    for (int i = 0; i < thread_count; ++i)
+    {
+        jobs[i] = (Job) {
+            .src = src,
+            .dst = dst,
+            .channels = channels,
+            .row_begin = dst->height * i / thread_count,
+            .row_end = dst->height * (i + 1) / thread_count,
+            .kernel = kernel,
+            .options = options,
+        };
+    }
+    for (int i = 1; i < thread_count; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, run_job, &jobs[i]) != 0)
+        {
+            // run it inline rather than fail the whole chain
+            run_job(&jobs[i]);
+            threads[i] = 0;
+        }
+    }
+    run_job(&jobs[0]);
+    for (int i = 1; i < thread_count; ++i)
+    {
+        if (threads[i])
+            pthread_join(threads[i], NULL);
+    }
+}
+
+bool mip_chain_build(MipChain* chain, const uint8_t* image, int width, int height, int channels, const MipOptions* options)
+{
+    assert(channels >= 1 && channels <= 4);
+    pthread_once(&lut_once, init_luts);
+
+    *chain = (MipChain) {0};
+    chain->channels = channels;
+    chain->levels[0] = (MipLevel) {(uint8_t*) image, width, height};
+    chain->level_count = 1;
+
+    Kernel kernel;
+    make_kernel(options->filter, &kernel);
+
+    int max_levels = options->max_levels > 0 && options->max_levels < MIP_MAX_LEVELS ? options->max_levels : MIP_MAX_LEVELS;
+    while (chain->level_count < max_levels)
+    {
+        const MipLevel* src = &chain->levels[chain->level_count - 1];
+        if (src->width == 1 && src->height == 1)
+            break;
+
+        MipLevel* dst = &chain->levels[chain->level_count];
+        dst->width = options->round_up ? (src->width + 1) / 2 : src->width / 2;
+        dst->height = options->round_up ? (src->height + 1) / 2 : src->height / 2;
+        dst->width = dst->width < 1 ? 1 : dst->width;
+        dst->height = dst->height < 1 ? 1 : dst->height;
+        dst->data = malloc((size_t) dst->width * dst->height * channels);
+        if (dst->data == NULL)
+        {
+            mip_chain_free(chain);
+            return false;
+        }
+        chain->level_count++;
+
+        build_level(src, dst, channels, &kernel, options);
+    }
+    return true;
+}
+
+void mip_chain_free(MipChain* chain)
+{
+    for (int i = 1; i < chain->level_count; ++i)
+        free(chain->levels[i].data);
+    *chain = (MipChain) {0};
+}
+
+const char* mip_filter_name(MipFilter filter)
+{
+    switch (filter)
+    {
+    case MIP_FILTER_KAISER:
+        return "kaiser";
+    case MIP_FILTER_LANCZOS:
+        return "lanczos";
+    case MIP_FILTER_BOX:
+    default:
+        return "box";
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MIP_MAX_LEVELS 16
+
+typedef enum MipFilter
+{
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER,
+    MIP_FILTER_LANCZOS,
+}MipFilter;
+
+typedef enum MipColorSpace
+{
+    MIP_COLOR_LINEAR,
+    MIP_COLOR_SRGB, // filter in linear light, alpha stays linear
+}MipColorSpace;
+
+typedef struct MipOptions
+{
+    MipFilter filter;
+    MipColorSpace color_space;
+    bool round_up;    // ceil(w/2) sizes for page tiling instead of GL's floor(w/2)
+    int max_levels;   // 0 builds down to 1x1
+    int thread_count; // 0 uses every online cpu
+}MipOptions;
+
+typedef struct MipLevel
+{
+    uint8_t* data;
+    int width;
+    int height;
+}MipLevel;
+
+/* Level 0 points at the caller's image and is never freed by the chain. */
+typedef struct MipChain
+{
+    int channels;
+    int level_count;
+    MipLevel levels[MIP_MAX_LEVELS];
+}MipChain;
+
+bool mip_chain_build(MipChain* chain, const uint8_t* image, int width, int height, int channels, const MipOptions* options);
+void mip_chain_free(MipChain* chain);
+
+const char* mip_filter_name(MipFilter filter);
+
+#endif // MIPMAP_H
@@ -0,0 +1,232 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define HAVE_SSSE3_DISPATCH 1
+#endif
+
+#include "pixel_convert.h"
+
+#define BLOCK_PIXELS 256 // staging block, small enough to stay in L1
+
+static uint8_t srgb_to_linear_lut[256];
+static uint8_t linear_to_srgb_lut[256];
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+
+static void init_luts(void)
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        float v = i / 255.0f;
+        float linear = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+        float srgb = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+        srgb_to_linear_lut[i] = (uint8_t) (linear * 255.0f + 0.5f);
+        linear_to_srgb_lut[i] = (uint8_t) (srgb * 255.0f + 0.5f);
+    }
+}
+
+static bool has_alpha(int channels)
+{
+    return channels == 2 || channels == 4;
+}
+
+PixelConversion pixel_conversion_make(int src_channels, unsigned int flags)
+{
+    PixelConversion conversion = {
+        .src_channels = src_channels,
+        .dst_channels = src_channels == 3 ? 4 : src_channels,
+        .flags = flags,
+    };
+    // premultiplying by an alpha that is always 255 is a no-op
+    if (!has_alpha(src_channels))
+        conversion.flags &= ~PIXEL_CONVERT_PREMULTIPLY;
+    return conversion;
+}
+
+static void expand_rgb_scalar(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+#ifdef HAVE_SSSE3_DISPATCH
+/* pshufb spreads four RGB texels over a register, SSE2 has no byte shuffle
+ * so the plain build falls back to scalar for this one. */
+__attribute__((target("ssse3")))
+static void expand_rgb_ssse3(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+    size_t i = 0;
+    // each load reads 16 bytes but consumes 12, stop while 4 spare bytes remain
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i rgb = _mm_loadu_si128((const __m128i*) (src + i * 3));
+        _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, spread), alpha));
+    }
+    expand_rgb_scalar(src + i * 3, dst + i * 4, count - i);
+}
+#endif
+
+static void expand_rgb(const uint8_t* src, uint8_t* dst, size_t count)
+{
+#ifdef HAVE_SSSE3_DISPATCH
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        expand_rgb_ssse3(src, dst, count);
+        return;
+    }
+#endif
+    expand_rgb_scalar(src, dst, count);
+}
+
+static void apply_lut(const uint8_t* lut, uint8_t* data, size_t count, int channels)
+{
+    size_t bytes = count * channels;
+    if (!has_alpha(channels))
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            data[i] = lut[data[i]];
+        return;
+    }
+    for (size_t i = 0; i < bytes; i += channels)
+        for (int c = 0; c < channels - 1; ++c)
+            data[i + c] = lut[data[i + c]];
+}
+
+// exact round(c * a / 255) for c, a <= 255
+static uint8_t mul_div_255(int c, int a)
+{
+    int t = c * a + 128;
+    return (uint8_t) ((t + (t >> 8)) >> 8);
+}
+
+static void premultiply(uint8_t* data, size_t count, int channels)
+{
+    size_t bytes = count * channels;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+    // alpha lanes get multiplied by 255 which the rounding maps back to alpha
+    const __m128i alpha_mask = channels == 4 ? _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0)
+                                             : _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i alpha_255 = _mm_and_si128(alpha_mask, _mm_set1_epi16(255));
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i texels = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i halves[2] = {_mm_unpacklo_epi8(texels, zero), _mm_unpackhi_epi8(texels, zero)};
+        for (int h = 0; h < 2; ++h)
+        {
+            __m128i a = channels == 4
+                ? _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[h], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3))
+                : _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[h], _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+            a = _mm_or_si128(_mm_andnot_si128(alpha_mask, a), alpha_255);
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(halves[h], a), round);
+            halves[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+        _mm_storeu_si128((__m128i*) (data + i), _mm_packus_epi16(halves[0], halves[1]));
+    }
+#endif
+    for (; i < bytes; i += channels)
+    {
+        int a = data[i + channels - 1];
+        for (int c = 0; c < channels - 1; ++c)
+            data[i + c] = mul_div_255(data[i + c], a);
+    }
+}
+
+void pixel_convert(const PixelConversion* conversion, const uint8_t* src, uint8_t* dst, size_t pixel_count)
+{
+    int src_channels = conversion->src_channels;
+    int dst_channels = conversion->dst_channels;
+    unsigned int flags = conversion->flags;
+
+    if (!flags)
+    {
+        // nothing to stage, write the destination in one streaming pass
+        if (src_channels == 3)
+            expand_rgb(src, dst, pixel_count);
+        else
+            memcpy(dst, src, pixel_count * src_channels);
+        return;
+    }
+
+    pthread_once(&lut_once, init_luts);
+    const uint8_t* lut = NULL;
+    if (flags & PIXEL_CONVERT_SRGB_TO_LINEAR)
+        lut = srgb_to_linear_lut;
+    else if (flags & PIXEL_CONVERT_LINEAR_TO_SRGB)
+        lut = linear_to_srgb_lut;
+
+    /* The per texel stages read back what they write, so they run on a small
+     * cached block and only the finished block goes out to dst. */
+    uint8_t block[BLOCK_PIXELS * 4];
+    for (size_t first = 0; first < pixel_count; first += BLOCK_PIXELS)
+    {
+        size_t count = pixel_count - first < BLOCK_PIXELS ? pixel_count - first : BLOCK_PIXELS;
+        const uint8_t* in = src + first * src_channels;
+        if (src_channels == 3)
+            expand_rgb(in, block, count);
+        else
+            memcpy(block, in, count * src_channels);
+
+        if (lut)
+            apply_lut(lut, block, count, dst_channels);
+        if (flags & PIXEL_CONVERT_PREMULTIPLY)
+            premultiply(block, count, dst_channels);
+        memcpy(dst + first * dst_channels, block, count * dst_channels);
+    }
+}
+
+void pixel_interleave4(const uint8_t* const planes[4], uint8_t fill, uint8_t* dst, size_t pixel_count)
+{
+    // missing planes read from a repeating block of fill so the loops stay branch free
+    uint8_t fill_block[BLOCK_PIXELS];
+    memset(fill_block, fill, sizeof(fill_block));
+    for (size_t first = 0; first < pixel_count; first += BLOCK_PIXELS)
+    {
+        size_t count = pixel_count - first < BLOCK_PIXELS ? pixel_count - first : BLOCK_PIXELS;
+        const uint8_t* r = planes[0] ? planes[0] + first : fill_block;
+        const uint8_t* g = planes[1] ? planes[1] + first : fill_block;
+        const uint8_t* b = planes[2] ? planes[2] + first : fill_block;
+        const uint8_t* a = planes[3] ? planes[3] + first : fill_block;
+        uint8_t* out = dst + first * 4;
+        size_t i = 0;
+#ifdef __SSE2__
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i vr = _mm_loadu_si128((const __m128i*) (r + i));
+            __m128i vg = _mm_loadu_si128((const __m128i*) (g + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+            __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i rg_lo = _mm_unpacklo_epi8(vr, vg);
+            __m128i rg_hi = _mm_unpackhi_epi8(vr, vg);
+            __m128i ba_lo = _mm_unpacklo_epi8(vb, va);
+            __m128i ba_hi = _mm_unpackhi_epi8(vb, va);
+            _mm_storeu_si128((__m128i*) (out + i * 4), _mm_unpacklo_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128((__m128i*) (out + i * 4 + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128((__m128i*) (out + i * 4 + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+            _mm_storeu_si128((__m128i*) (out + i * 4 + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            out[i * 4 + 0] = r[i];
+            out[i * 4 + 1] = g[i];
+            out[i * 4 + 2] = b[i];
+            out[i * 4 + 3] = a[i];
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum PixelConvertFlags
+{
+    PIXEL_CONVERT_SRGB_TO_LINEAR = 1 << 0,
+    PIXEL_CONVERT_LINEAR_TO_SRGB = 1 << 1,
+    PIXEL_CONVERT_PREMULTIPLY    = 1 << 2, // after any colour space change
+}PixelConvertFlags;
+
+/* Turns decoded 8 bit images into the layout the texture upload wants.
+ * Gray stays one channel (R8), gray+alpha stays RG8 and RGB grows an opaque
+ * alpha so every colour upload is RGBA8. Alpha is never colour converted. */
+typedef struct PixelConversion
+{
+    int src_channels;
+    int dst_channels;
+    unsigned int flags;
+}PixelConversion;
+
+PixelConversion pixel_conversion_make(int src_channels, unsigned int flags);
+
+/* dst may be write-combined memory such as a mapped pixel buffer, it is only
+ * ever written front to back and never read. */
+void pixel_convert(const PixelConversion* conversion, const uint8_t* src, uint8_t* dst, size_t pixel_count);
+
+/* Interleaves up to four single channel planes into RGBA8. A NULL plane
+ * fills its channel with fill. Like pixel_convert, dst is only written. */
+void pixel_interleave4(const uint8_t* const planes[4], uint8_t fill, uint8_t* dst, size_t pixel_count);
+
+#endif // PIXEL_CONVERT_H
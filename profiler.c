@@ -0,0 +1,338 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glad/glad.h"
+#include "profiler.h"
+#include "util.h"
+
+#define RING_MASK (PROFILER_RING_EVENTS - 1)
+#define SUMMARY_MAX_NAMES 64
+
+_Static_assert((PROFILER_RING_EVENTS & RING_MASK) == 0, "ring size must be a power of two");
+
+/* Single producer ring. Only the owning thread writes events and bumps head,
+ * readers take head with acquire and look at the last PROFILER_RING_EVENTS
+ * entries, older ones have been overwritten. */
+typedef struct ProfilerThread
+{
+    char name[32];
+    int id;
+    _Atomic uint64_t head;
+    ProfilerEvent events[PROFILER_RING_EVENTS];
+
+    int depth;
+    const char* stack_names[PROFILER_MAX_DEPTH];
+    uint64_t stack_begin[PROFILER_MAX_DEPTH];
+}ProfilerThread;
+
+typedef struct GpuTimers
+{
+    bool enabled;
+    bool active;
+    bool dropped; // the open scope had no free query
+    unsigned int queries[PROFILER_GPU_FRAMES][PROFILER_GPU_SCOPES];
+    const char* names[PROFILER_GPU_FRAMES][PROFILER_GPU_SCOPES];
+    uint64_t begin_ns[PROFILER_GPU_FRAMES][PROFILER_GPU_SCOPES];
+    int count[PROFILER_GPU_FRAMES];
+    ProfilerThread* track;
+}GpuTimers;
+
+static bool enabled = false;
+static uint64_t start_ns;
+static _Atomic uint32_t frame;
+static _Atomic int thread_count;
+static ProfilerThread* _Atomic threads[PROFILER_MAX_THREADS];
+static _Thread_local ProfilerThread* current_thread;
+static GpuTimers gpu;
+
+static ProfilerThread* register_thread(const char* name)
+{
+    int id = atomic_fetch_add(&thread_count, 1);
+    if (id >= PROFILER_MAX_THREADS)
+        return NULL;
+    ProfilerThread* thread = calloc(1, sizeof(ProfilerThread));
+    if (!thread)
+        return NULL;
+    thread->id = id;
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
+    atomic_store_explicit(&threads[id], thread, memory_order_release);
+    return thread;
+}
+
+static ProfilerThread* get_thread(void)
+{
+    if (!current_thread)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "thread %d", atomic_load(&thread_count));
+        current_thread = register_thread(name);
+    }
+    return current_thread;
+}
+
+static void push_event(ProfilerThread* thread, const ProfilerEvent* event)
+{
+    uint64_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+    thread->events[head & RING_MASK] = *event;
+    atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+bool profiler_init(bool gpu_timers)
+{
+    start_ns = time_now_ns();
+    enabled = true;
+    if (gpu_timers)
+    {
+        glGenQueries(PROFILER_GPU_FRAMES * PROFILER_GPU_SCOPES, gpu.queries[0]);
+        gpu.track = register_thread("GPU");
+        gpu.enabled = gpu.track != NULL;
+    }
+    return true;
+}
+
+void profiler_shutdown(void)
+{
+    if (!enabled)
+        return;
+    enabled = false;
+    if (gpu.enabled)
+        glDeleteQueries(PROFILER_GPU_FRAMES * PROFILER_GPU_SCOPES, gpu.queries[0]);
+    gpu.enabled = false;
+    // other threads must have stopped recording by now
+    int count = atomic_load(&thread_count);
+    for (int i = 0; i < count && i < PROFILER_MAX_THREADS; ++i)
+    {
+        free(atomic_load(&threads[i]));
+        atomic_store(&threads[i], NULL);
+    }
+    atomic_store(&thread_count, 0);
+    current_thread = NULL;
+}
+
+void profiler_set_thread_name(const char* name)
+{
+    if (!enabled)
+        return;
+    if (!current_thread)
+        current_thread = register_thread(name);
+    else
+        snprintf(current_thread->name, sizeof(current_thread->name), "%s", name);
+}
+
+void profiler_begin(const char* name)
+{
+    if (!enabled)
+        return;
+    ProfilerThread* thread = get_thread();
+    if (!thread)
+        return;
+    // scopes past the maximum depth are counted so ends still pair up, but not recorded
+    if (thread->depth < PROFILER_MAX_DEPTH)
+    {
+        thread->stack_names[thread->depth] = name;
+        thread->stack_begin[thread->depth] = time_now_ns();
+    }
+    ++thread->depth;
+}
+
+void profiler_end(void)
+{
+    if (!enabled)
+        return;
+    ProfilerThread* thread = get_thread();
+    if (!thread || thread->depth == 0)
+        return;
+    int depth = --thread->depth;
+    if (depth >= PROFILER_MAX_DEPTH)
+        return;
+    ProfilerEvent event = {
+        .name = thread->stack_names[depth],
+        .begin_ns = thread->stack_begin[depth],
+        .end_ns = time_now_ns(),
+        .depth = (uint32_t) depth,
+        .frame = atomic_load_explicit(&frame, memory_order_relaxed),
+    };
+    push_event(thread, &event);
+}
+
+void profiler_gpu_begin(const char* name)
+{
+    if (!enabled || !gpu.enabled || gpu.active)
+        return;
+    int set = atomic_load_explicit(&frame, memory_order_relaxed) % PROFILER_GPU_FRAMES;
+    gpu.active = true;
+    gpu.dropped = gpu.count[set] == PROFILER_GPU_SCOPES;
+    if (gpu.dropped)
+        return;
+    int slot = gpu.count[set];
+    gpu.names[set][slot] = name;
+    gpu.begin_ns[set][slot] = time_now_ns();
+    glBeginQuery(GL_TIME_ELAPSED, gpu.queries[set][slot]);
+}
+
+void profiler_gpu_end(void)
+{
+    if (!enabled || !gpu.enabled || !gpu.active)
+        return;
+    gpu.active = false;
+    if (gpu.dropped)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    ++gpu.count[atomic_load_explicit(&frame, memory_order_relaxed) % PROFILER_GPU_FRAMES];
+}
+
+void profiler_frame_end(void)
+{
+    if (!enabled)
+        return;
+    uint32_t finished = atomic_fetch_add(&frame, 1);
+    if (!gpu.enabled)
+        return;
+
+    /* The set the next frame is about to reuse was filled PROFILER_GPU_FRAMES - 1
+     * frames ago, so its results are normally ready and reading them does not
+     * stall. GPU events only carry a measured duration, they are placed at the
+     * time the CPU issued them. */
+    int set = (finished + 1) % PROFILER_GPU_FRAMES;
+    uint64_t now = time_now_ns();
+    for (int i = 0; i < gpu.count[set]; ++i)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(gpu.queries[set][i], GL_QUERY_RESULT, &elapsed);
+        // some drivers (llvmpipe) report garbage for the first query of a context
+        if (gpu.begin_ns[set][i] + elapsed > now)
+            continue;
+        ProfilerEvent event = {
+            .name = gpu.names[set][i],
+            .begin_ns = gpu.begin_ns[set][i],
+            .end_ns = gpu.begin_ns[set][i] + elapsed,
+            .frame = finished + 1 - PROFILER_GPU_FRAMES,
+        };
+        push_event(gpu.track, &event);
+    }
+    gpu.count[set] = 0;
+}
+
+static void write_json_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (; *text; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', file);
+        if ((unsigned char) *text >= 0x20)
+            fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+bool profiler_write_chrome_trace(const char* path)
+{
+    if (!enabled)
+        return false;
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        perror("Error writing trace");
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int count = atomic_load(&thread_count);
+    for (int t = 0; t < count && t < PROFILER_MAX_THREADS; ++t)
+    {
+        ProfilerThread* thread = atomic_load_explicit(&threads[t], memory_order_acquire);
+        if (!thread)
+            continue;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+        write_json_string(file, thread->name);
+        fprintf(file, "}}");
+        first = false;
+
+        uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+        uint64_t tail = head > PROFILER_RING_EVENTS ? head - PROFILER_RING_EVENTS : 0;
+        for (uint64_t i = tail; i < head; ++i)
+        {
+            const ProfilerEvent* event = &thread->events[i & RING_MASK];
+            fprintf(file, ",\n{\"name\":");
+            write_json_string(file, event->name);
+            fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%u}}",
+                    thread == gpu.track ? "gpu" : "cpu", (event->begin_ns - start_ns) / 1e3,
+                    (event->end_ns - event->begin_ns) / 1e3, thread->id, event->frame);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+void profiler_for_each_event(ProfilerVisit visit, void* user)
+{
+    if (!enabled)
+        return;
+    int count = atomic_load(&thread_count);
+    for (int t = 0; t < count && t < PROFILER_MAX_THREADS; ++t)
+    {
+        ProfilerThread* thread = atomic_load_explicit(&threads[t], memory_order_acquire);
+        if (!thread)
+            continue;
+        uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+        uint64_t tail = head > PROFILER_RING_EVENTS ? head - PROFILER_RING_EVENTS : 0;
+        for (uint64_t i = tail; i < head; ++i)
+            visit(thread->name, &thread->events[i & RING_MASK], user);
+    }
+}
+
+typedef struct ScopeSummary
+{
+    const char* name;
+    const char* thread;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+}ScopeSummary;
+
+typedef struct Summary
+{
+    ScopeSummary scopes[SUMMARY_MAX_NAMES];
+    int scope_count;
+}Summary;
+
+static void summarize_event(const char* thread, const ProfilerEvent* event, void* user)
+{
+    Summary* summary = user;
+    int s = 0;
+    while (s < summary->scope_count && !(summary->scopes[s].name == event->name && summary->scopes[s].thread == thread))
+        ++s;
+    if (s == summary->scope_count)
+    {
+        if (summary->scope_count == SUMMARY_MAX_NAMES)
+            return;
+        summary->scopes[summary->scope_count++] = (ScopeSummary) {.name = event->name, .thread = thread};
+    }
+    uint64_t duration = event->end_ns - event->begin_ns;
+    ScopeSummary* scope = &summary->scopes[s];
+    scope->count++;
+    scope->total_ns += duration;
+    if (duration > scope->max_ns)
+        scope->max_ns = duration;
+}
+
+/* Average and worst time per scope over whatever history the rings still hold. */
+void profiler_print_summary(void)
+{
+    if (!enabled)
+        return;
+    Summary summary = {0};
+    profiler_for_each_event(summarize_event, &summary);
+
+    printf("%-10s %-24s %8s %10s %10s\n", "thread", "scope", "count", "avg ms", "max ms");
+    for (int s = 0; s < summary.scope_count; ++s)
+    {
+        const ScopeSummary* scope = &summary.scopes[s];
+        printf("%-10s %-24s %8lu %10.3f %10.3f\n", scope->thread, scope->name, (unsigned long) scope->count,
+               scope->total_ns / 1e6 / scope->count, scope->max_ns / 1e6);
+    }
+}
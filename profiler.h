@@ -0,0 +1,47 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILER_MAX_THREADS 16
+#define PROFILER_RING_EVENTS 65536 // per thread, power of two
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_GPU_SCOPES 32     // per frame
+#define PROFILER_GPU_FRAMES 2      // query sets in flight, read back one frame late
+
+typedef struct ProfilerEvent
+{
+    const char* name; // must outlive the profiler, string literals in practice
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    uint32_t depth;
+    uint32_t frame;
+}ProfilerEvent;
+
+/* All calls are no-ops until profiler_init. CPU scopes may be opened from
+ * any thread and nest, each thread records into its own ring so no locks
+ * are taken. GPU scopes belong to the GL thread and cannot nest because
+ * only one GL_TIME_ELAPSED query may be active at a time. */
+bool profiler_init(bool gpu_timers);
+void profiler_shutdown(void);
+void profiler_set_thread_name(const char* name);
+
+void profiler_begin(const char* name);
+void profiler_end(void);
+
+void profiler_gpu_begin(const char* name);
+void profiler_gpu_end(void);
+
+/* Call once per frame after the swap. Collects the GPU queries from the
+ * previous frame and advances the frame counter. */
+void profiler_frame_end(void);
+
+/* Visits every event still held in the rings, oldest first per thread. */
+typedef void (*ProfilerVisit)(const char* thread, const ProfilerEvent* event, void* user);
+void profiler_for_each_event(ProfilerVisit visit, void* user);
+
+bool profiler_write_chrome_trace(const char* path);
+void profiler_print_summary(void);
+
+#endif // PROFILER_H
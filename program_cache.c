@@ -0,0 +1,321 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "glad/glad.h"
+#include "mesh_cache.h"
+#include "program_cache.h"
+#include "util.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// the terminator goes in too so "ab" + "c" and "a" + "bc" differ
+static uint64_t hash_string(uint64_t hash, const char* string)
+{
+    if (!string)
+        string = "";
+    return hash_bytes(hash, string, strlen(string) + 1);
+}
+
+static bool binary_supported(void)
+{
+    if (!GLAD_GL_ARB_get_program_binary && !GLAD_GL_VERSION_4_1)
+        return false;
+    int format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+}
+
+uint64_t program_cache_key(const ProgramSource* source)
+{
+    uint64_t hash = FNV_OFFSET;
+    hash = hash_bytes(hash, &source->vertex_size, sizeof(source->vertex_size));
+    hash = hash_bytes(hash, source->vertex, source->vertex_size);
+    hash = hash_bytes(hash, &source->fragment_size, sizeof(source->fragment_size));
+    hash = hash_bytes(hash, source->fragment, source->fragment_size);
+    hash = hash_string(hash, source->defines);
+    hash = hash_string(hash, (const char*) glGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char*) glGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char*) glGetString(GL_VERSION));
+
+    if (binary_supported())
+    {
+        int format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        int* formats = calloc(format_count, sizeof(int));
+        if (formats)
+        {
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+            hash = hash_bytes(hash, formats, sizeof(int) * format_count);
+            free(formats);
+        }
+    }
+    hash ^= PROGRAM_CACHE_VERSION;
+    return hash;
+}
+
+/* The defines have to come after #version, which must be the first thing
+ * in the shader, so the source is handed over in up to four pieces. The
+ * status is left for program_cache_poll, asking now would wait for the
+ * compile. */
+static unsigned int submit_shader(const char* src, size_t size, const char* defines, int type)
+{
+    static const char line_reset[] = "#line 2\n";
+    const char* strings[4];
+    int lengths[4];
+    int count = 0;
+    size_t head = 0;
+    if (defines && size > 8 && strncmp(src, "#version", 8) == 0)
+    {
+        const char* eol = memchr(src, '\n', size);
+        head = eol ? (size_t) (eol - src) + 1 : size;
+        strings[count] = src;
+        lengths[count++] = (int) head;
+    }
+    if (defines)
+    {
+        strings[count] = defines;
+        lengths[count++] = (int) strlen(defines);
+    }
+    // errors keep the line numbers of the file
+    if (head)
+    {
+        strings[count] = line_reset;
+        lengths[count++] = (int) sizeof(line_reset) - 1;
+    }
+    strings[count] = src + head;
+    lengths[count++] = (int) (size - head);
+
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, count, strings, lengths);
+    glCompileShader(shader);
+    return shader;
+}
+
+static void print_shader_log(unsigned int shader, int type)
+{
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::%s::COMPILATION_FAILED\n%s", type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT", infoLog);
+    }
+}
+
+static bool load_binary(const char* path, uint64_t key, unsigned int* program, size_t* binary_size)
+{
+    // a miss is expected on a cold start, only other failures are worth reporting
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        if (errno != ENOENT)
+            perror("Error reading program cache");
+        return false;
+    }
+    FileSpan file;
+    if (!map_file(path, &file, FILE_ACCESS_SEQUENTIAL))
+        return false;
+
+    const ProgramCacheHeader* header = (const ProgramCacheHeader*) file.data;
+    bool ok = file.size >= sizeof(ProgramCacheHeader)
+        && header->magic == PROGRAM_CACHE_MAGIC
+        && header->version == PROGRAM_CACHE_VERSION
+        && header->key == key
+        && file.size - sizeof(ProgramCacheHeader) >= header->length;
+    if (ok)
+    {
+        *program = glCreateProgram();
+        glProgramBinary(*program, header->format, file.data + sizeof(ProgramCacheHeader), (int) header->length);
+
+        // the driver may still refuse it, after an update that kept the version string for example
+        int success;
+        glGetProgramiv(*program, GL_LINK_STATUS, &success);
+        ok = success;
+        if (!ok)
+            glDeleteProgram(*program);
+        *binary_size = header->length;
+    }
+    unmap_file(&file);
+    return ok;
+}
+
+static bool store_binary(const char* path, uint64_t key, unsigned int program, size_t* binary_size)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    void* binary = malloc(length);
+    if (!binary)
+        return false;
+
+    ProgramCacheHeader header = {
+        .magic = PROGRAM_CACHE_MAGIC,
+        .version = PROGRAM_CACHE_VERSION,
+        .key = key,
+    };
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary);
+    header.format = format;
+    header.length = (uint32_t) length;
+
+    if (mkdir(MESH_CACHE_DIR, 0755) != 0 && errno != EEXIST)
+    {
+        perror("Error creating cache directory");
+        free(binary);
+        return false;
+    }
+
+    char tmp_path[PROGRAM_CACHE_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* file;
+    if ((file = fopen(tmp_path, "wb")) == NULL)
+    {
+        perror("Error writing program cache");
+        free(binary);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(binary, 1, header.length, file) == header.length;
+    ok = (fclose(file) == 0) && ok;
+    free(binary);
+
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        perror("Error writing program cache");
+        remove(tmp_path);
+        return false;
+    }
+    *binary_size = header.length;
+    return true;
+}
+
+static bool parallel_compile;
+
+bool program_cache_init(void)
+{
+    // 0xffffffff hands the choice to the driver
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+    parallel_compile = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    return parallel_compile;
+}
+
+bool program_cache_submit(ProgramBuild* build, const ProgramSource* source)
+{
+    *build = (ProgramBuild) {.start_ns = time_now_ns(), .state = PROGRAM_BUILD_PENDING};
+    build->cacheable = binary_supported();
+    build->key = program_cache_key(source);
+    snprintf(build->path, sizeof(build->path), MESH_CACHE_DIR "/%s.program", source->name);
+
+    if (build->cacheable && load_binary(build->path, build->key, &build->program, &build->stats.binary_size))
+    {
+        build->stats.hit = true;
+        build->state = PROGRAM_BUILD_READY;
+        build->stats.submit_ns = build->stats.ns = time_now_ns() - build->start_ns;
+        return true;
+    }
+
+    build->shaders[0] = submit_shader(source->vertex, source->vertex_size, source->defines, GL_VERTEX_SHADER);
+    build->shaders[1] = submit_shader(source->fragment, source->fragment_size, source->defines, GL_FRAGMENT_SHADER);
+    build->program = glCreateProgram();
+    if (!build->shaders[0] || !build->shaders[1] || !build->program)
+    {
+        printf("ERROR::SHADER::PROGRAM::CREATE_FAILED\n");
+        glDeleteShader(build->shaders[0]);
+        glDeleteShader(build->shaders[1]);
+        glDeleteProgram(build->program);
+        *build = (ProgramBuild) {.state = PROGRAM_BUILD_FAILED};
+        return false;
+    }
+    if (build->cacheable)
+        glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(build->program, build->shaders[0]);
+    glAttachShader(build->program, build->shaders[1]);
+    // a stage that failed to compile fails the link too, so only the program needs watching
+    glLinkProgram(build->program);
+    build->stats.submit_ns = time_now_ns() - build->start_ns;
+    return true;
+}
+
+static bool finish(ProgramBuild* build, bool block)
+{
+    if (build->state != PROGRAM_BUILD_PENDING)
+        return true;
+    if (parallel_compile && !block)
+    {
+        int done = GL_FALSE;
+        glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done)
+            return false;
+    }
+
+    int success;
+    glGetProgramiv(build->program, GL_LINK_STATUS, &success);
+    build->stats.ns = time_now_ns() - build->start_ns;
+    if (!success)
+    {
+        char infoLog[512];
+        print_shader_log(build->shaders[0], GL_VERTEX_SHADER);
+        print_shader_log(build->shaders[1], GL_FRAGMENT_SHADER);
+        glGetProgramInfoLog(build->program, 512, NULL, infoLog);
+        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", infoLog);
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        glDetachShader(build->program, build->shaders[i]);
+        glDeleteShader(build->shaders[i]);
+        build->shaders[i] = 0;
+    }
+    if (!success)
+    {
+        glDeleteProgram(build->program);
+        build->program = 0;
+        build->state = PROGRAM_BUILD_FAILED;
+        return true;
+    }
+
+    build->state = PROGRAM_BUILD_READY;
+    if (build->cacheable)
+        build->stats.stored = store_binary(build->path, build->key, build->program, &build->stats.binary_size);
+    return true;
+}
+
+bool program_cache_poll(ProgramBuild* build)
+{
+    return finish(build, false);
+}
+
+void program_cache_wait(ProgramBuild* build)
+{
+    finish(build, true);
+}
+
+bool program_cache_load(const ProgramSource* source, unsigned int* program, ProgramCacheStats* stats)
+{
+    ProgramBuild build;
+    bool ok = program_cache_submit(&build, source);
+    if (ok)
+        program_cache_wait(&build);
+    *program = build.program;
+    *stats = build.stats;
+    return build.state == PROGRAM_BUILD_READY;
+}
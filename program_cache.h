@@ -0,0 +1,91 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROGRAM_CACHE_MAGIC 0x474f5250 // "PROG"
+#define PROGRAM_CACHE_VERSION 1
+#define PROGRAM_CACHE_PATH_MAX 512
+
+/* Cache file header, the driver's binary follows it. The key covers
+ * everything the binary depends on, so a header that doesn't match is
+ * simply a miss. */
+typedef struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format; // from glGetProgramBinary
+    uint32_t length;
+}ProgramCacheHeader;
+
+/* Sources of one program. defines, if not NULL, is a block of #define lines
+ * that goes in right after the #version line of both stages. */
+typedef struct ProgramSource
+{
+    const char* name; // names the cache file
+    const char* vertex;
+    size_t vertex_size;
+    const char* fragment;
+    size_t fragment_size;
+    const char* defines;
+}ProgramSource;
+
+typedef struct ProgramCacheStats
+{
+    bool hit;
+    bool stored;
+    size_t binary_size;
+    uint64_t submit_ns; // spent issuing the work, the only part the caller waits for
+    uint64_t ns;        // from submit until the program was seen linked
+}ProgramCacheStats;
+
+typedef enum ProgramBuildState
+{
+    PROGRAM_BUILD_NONE,    // nothing submitted
+    PROGRAM_BUILD_PENDING, // compile and link issued, the driver may still be working on them
+    PROGRAM_BUILD_READY,
+    PROGRAM_BUILD_FAILED,
+}ProgramBuildState;
+
+/* One program on its way from sources or a cached binary to a linked
+ * object. Nothing asks the driver for a status until program_cache_poll,
+ * so with KHR_parallel_shader_compile any number of builds compile side by
+ * side while the caller keeps drawing with something else. */
+typedef struct ProgramBuild
+{
+    char path[PROGRAM_CACHE_PATH_MAX];
+    uint64_t key;
+    unsigned int program;
+    unsigned int shaders[2]; // 0 when loaded from a binary
+    bool cacheable;
+    uint64_t start_ns;
+    ProgramBuildState state;
+    ProgramCacheStats stats;
+}ProgramBuild;
+
+/* Lets the driver pick its own number of compiler threads. Call once after
+ * the context is current. Returns whether builds complete in the
+ * background, without it program_cache_poll blocks on the first call. */
+bool program_cache_init(void);
+/* Key over the sources, the defines and the driver: vendor, renderer and
+ * version strings and the binary formats it supports. Needs a current
+ * context. */
+uint64_t program_cache_key(const ProgramSource* source);
+/* Loads the program from the cached binary when there is one for this key
+ * and the driver still takes it, that is ready on return. Otherwise issues
+ * the compiles and the link. The sources are copied by the driver and may
+ * go away on return. */
+bool program_cache_submit(ProgramBuild* build, const ProgramSource* source);
+/* False while the driver is still busy. Once it is done, checks the
+ * result, prints the logs of a failed build and stores the binary of a
+ * fresh link. build->state says how it went. */
+bool program_cache_poll(ProgramBuild* build);
+void program_cache_wait(ProgramBuild* build);
+/* submit and wait in one, for programs that are needed right away. Without
+ * ARB_get_program_binary it always compiles. */
+bool program_cache_load(const ProgramSource* source, unsigned int* program, ProgramCacheStats* stats);
+
+#endif // PROGRAM_CACHE_H
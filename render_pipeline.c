@@ -0,0 +1,109 @@
+#include <stdio.h>
+
+#include "profiler.h"
+#include "render_pipeline.h"
+#include "util.h"
+
+static void build_packet(RenderPipeline* pipeline, FramePacket* packet, uint32_t frame)
+{
+    profiler_begin("build frame");
+    packet->frame = frame;
+    command_buffer_reset(&packet->commands);
+    pipeline->build(packet, pipeline->user);
+    command_buffer_sort(&packet->commands);
+    profiler_end();
+}
+
+static void* build_thread(void* arg)
+{
+    RenderPipeline* pipeline = arg;
+    profiler_set_thread_name("render worker");
+    pthread_mutex_lock(&pipeline->lock);
+    while (true)
+    {
+        uint64_t wait_start = time_now_ns();
+        while (pipeline->running && pipeline->built == pipeline->released + RENDER_PIPELINE_DEPTH)
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        pipeline->build_wait_ns += time_now_ns() - wait_start;
+        if (!pipeline->running)
+            break;
+
+        // the slot is ours until built is bumped, the GL thread never looks at it
+        uint32_t frame = pipeline->built;
+        pthread_mutex_unlock(&pipeline->lock);
+        build_packet(pipeline, &pipeline->packets[frame % RENDER_PIPELINE_DEPTH], frame);
+        pthread_mutex_lock(&pipeline->lock);
+
+        pipeline->built++;
+        pthread_cond_broadcast(&pipeline->changed);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+bool render_pipeline_init(RenderPipeline* pipeline, FrameBuildFn build, void* user, bool threaded)
+{
+    *pipeline = (RenderPipeline) {
+        .build = build,
+        .user = user,
+        .threaded = threaded,
+        .running = true,
+    };
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->changed, NULL);
+    if (threaded && pthread_create(&pipeline->thread, NULL, build_thread, pipeline) != 0)
+    {
+        perror("Error starting render worker");
+        pipeline->threaded = false;
+        return false;
+    }
+    return true;
+}
+
+const FramePacket* render_pipeline_acquire(RenderPipeline* pipeline)
+{
+    FramePacket* packet = &pipeline->packets[pipeline->acquired % RENDER_PIPELINE_DEPTH];
+    if (!pipeline->threaded)
+    {
+        build_packet(pipeline, packet, pipeline->acquired++);
+        return packet;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    uint64_t wait_start = time_now_ns();
+    while (pipeline->built == pipeline->acquired)
+        pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+    pipeline->submit_wait_ns += time_now_ns() - wait_start;
+    pipeline->acquired++;
+    pthread_mutex_unlock(&pipeline->lock);
+    return packet;
+}
+
+void render_pipeline_release(RenderPipeline* pipeline)
+{
+    if (!pipeline->threaded)
+    {
+        pipeline->released++;
+        return;
+    }
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->released++;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+void render_pipeline_shutdown(RenderPipeline* pipeline)
+{
+    if (pipeline->threaded)
+    {
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->running = false;
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+        pthread_join(pipeline->thread, NULL);
+    }
+    for (int i = 0; i < RENDER_PIPELINE_DEPTH; ++i)
+        command_buffer_free(&pipeline->packets[i].commands);
+    pthread_cond_destroy(&pipeline->changed);
+    pthread_mutex_destroy(&pipeline->lock);
+}
@@ -0,0 +1,56 @@
+#ifndef RENDER_PIPELINE_H
+#define RENDER_PIPELINE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "command_buffer.h"
+#include "transform.h"
+#include "virtual_texture.h"
+
+#define RENDER_PIPELINE_DEPTH 2 // packets in flight, one being built while one is submitted
+
+/* One frame worth of work for the GL thread. Built without touching GL, so
+ * it can be filled on any thread. Matrices are row major like the rest of
+ * transform.c and get uploaded with transpose set. The builder sorts the
+ * commands, the GL thread only executes them. */
+typedef struct FramePacket
+{
+    uint32_t frame;
+    float view[MATRIX_SIZE];
+    float projection[MATRIX_SIZE];
+    VirtualTextureView vt_view;
+    CommandBuffer commands;
+}FramePacket;
+
+typedef void (*FrameBuildFn)(FramePacket* packet, void* user);
+
+/* Double buffered hand off between a build thread and the GL thread.
+ * Threaded, the worker fills packet N+1 while the GL thread submits packet N
+ * and blocks only when it is a whole packet ahead. Not threaded, acquire
+ * builds the packet inline, which is the old serial loop. */
+typedef struct RenderPipeline
+{
+    FramePacket packets[RENDER_PIPELINE_DEPTH];
+    FrameBuildFn build;
+    void* user;
+    bool threaded;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    uint32_t built;    // packets finished by the builder
+    uint32_t acquired; // packets handed to the GL thread
+    uint32_t released; // packets the GL thread is done with
+    uint64_t build_wait_ns;  // builder blocked on a free packet
+    uint64_t submit_wait_ns; // GL thread blocked on a built packet
+}RenderPipeline;
+
+bool render_pipeline_init(RenderPipeline* pipeline, FrameBuildFn build, void* user, bool threaded);
+const FramePacket* render_pipeline_acquire(RenderPipeline* pipeline);
+void render_pipeline_release(RenderPipeline* pipeline);
+void render_pipeline_shutdown(RenderPipeline* pipeline);
+
+#endif // RENDER_PIPELINE_H
@@ -1,17 +1,56 @@
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
 #include "glad/glad.h"
 #include "render_window.h"
+#include "util.h"
 
-static bool mouse_dragging = false;
+static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
-static double mouse_dragging_x = 0.0;
-static double mouse_dragging_y = 0.0;
+static void queue_event(GLFWwindow* glfw_window, InputEvent event)
+{
+    RenderWindow* window = glfwGetWindowUserPointer(glfw_window);
+    event.time_ns = time_now_ns();
+    input_queue_push(&window->input_queue, &event);
+}
 
-static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+static void key_callback(GLFWwindow* glfw_window, int key, int scancode, int action, int mods)
+{
+    (void) scancode;
+    queue_event(glfw_window, (InputEvent) {.type = INPUT_EVENT_KEY, .action = (uint8_t) action, .code = (int16_t) key, .mods = mods});
+}
+
+static void mouse_button_callback(GLFWwindow* glfw_window, int button, int action, int mods)
+{
+    queue_event(glfw_window, (InputEvent) {.type = INPUT_EVENT_MOUSE_BUTTON, .action = (uint8_t) action, .code = (int16_t) button, .mods = mods});
+}
+
+static void cursor_callback(GLFWwindow* glfw_window, double x, double y)
+{
+    queue_event(glfw_window, (InputEvent) {.type = INPUT_EVENT_CURSOR, .x = x, .y = y});
+}
+
+static void scroll_callback(GLFWwindow* glfw_window, double x, double y)
+{
+    queue_event(glfw_window, (InputEvent) {.type = INPUT_EVENT_SCROLL, .x = x, .y = y});
+}
+
+static void load_gl(RenderWindow* window, GLADloadproc load)
+{
+    uint64_t start = time_now_ns();
+    if (!gladLoadGLLoader(load))
+    {
+        printf("Failed to initialize GLAD\n");
+        exit(1);
+    }
+    window->gl_load_ns = time_now_ns() - start;
+}
 
 void render_window_init(RenderWindow* window, int width, int height, const char* title)
 {
@@ -29,75 +68,218 @@ void render_window_init(RenderWindow* window, int width, int height, const char*
     }
     glfwMakeContextCurrent(glfw_window);
     glfwSetFramebufferSizeCallback(glfw_window, framebuffer_size_callback);
+    glfwSetWindowUserPointer(glfw_window, window);
+    glfwSetKeyCallback(glfw_window, key_callback);
+    glfwSetMouseButtonCallback(glfw_window, mouse_button_callback);
+    glfwSetCursorPosCallback(glfw_window, cursor_callback);
+    glfwSetScrollCallback(glfw_window, scroll_callback);
 
     window->window = glfw_window;
+    window->width = width;
+    window->height = height;
+    input_map_init(&window->input_map);
+    // nothing arrives until the cursor moves, start from where it is
+    glfwGetCursorPos(glfw_window, &window->input_map.cursor_x, &window->input_map.cursor_y);
+    load_gl(window, (GLADloadproc) glfwGetProcAddress);
 }
-void render_window_process_input(RenderWindow *window)
+
+static EGLDisplay get_headless_display(void)
 {
-    if (glfwGetKey(window->window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    // surfaceless needs no display server or GPU, Mesa falls back to llvmpipe
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (get_platform_display && extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+        return get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static void* headless_proc_address(const char* name)
+{
+    return (void*) eglGetProcAddress(name);
+}
+
+void render_window_init_headless(RenderWindow* window, int width, int height, int frame_limit)
+{
+    EGLDisplay display = get_headless_display();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
     {
-        glfwSetWindowShouldClose(window->window, true);
+        printf("Failed to initialize EGL\n");
+        exit(1);
     }
-    if (glfwGetKey(window->window, GLFW_KEY_W) == GLFW_PRESS)
+
+    EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    eglChooseConfig(display, config_attribs, &config, 1, &config_count);
+
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    eglBindAPI(EGL_OPENGL_API);
+    EGLContext context = eglCreateContext(display, config_count ? config : NULL, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
     {
-        assert(window->callbacks[GLFW_KEY_W]);
-        window->callbacks[GLFW_KEY_W]();
+        printf("Failed to create headless GL context (EGL error 0x%x)\n", eglGetError());
+        eglTerminate(display);
+        exit(1);
     }
-    if (glfwGetKey(window->window, GLFW_KEY_A) == GLFW_PRESS)
+    load_gl(window, (GLADloadproc) headless_proc_address);
+
+    // without a surface there is no default framebuffer, draw into our own
+    glGenFramebuffers(1, &window->framebuffer);
+    glGenRenderbuffers(2, window->renderbuffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, window->framebuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, window->renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, window->renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, window->renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, window->renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
-        assert(window->callbacks[GLFW_KEY_A]);
-        window->callbacks[GLFW_KEY_A]();
+        printf("Headless framebuffer is incomplete\n");
+        exit(1);
     }
-    if (glfwGetKey(window->window, GLFW_KEY_S) == GLFW_PRESS)
+    glViewport(0, 0, width, height);
+
+    window->headless = true;
+    window->egl_display = display;
+    window->egl_context = context;
+    window->width = width;
+    window->height = height;
+    window->frame_limit = frame_limit;
+    input_map_init(&window->input_map);
+    // parked in the middle, a headless run never drags
+    window->input_map.cursor_x = width / 2.0;
+    window->input_map.cursor_y = height / 2.0;
+    printf("headless %dx%d on %s (EGL %d.%d)\n", width, height, glGetString(GL_RENDERER), major, minor);
+}
+
+void render_window_capture_frame(RenderWindow* window, const char* path)
+{
+    if (!window->capture.running && !frame_capture_init(&window->capture, window->width, window->height))
     {
-        assert(window->callbacks[GLFW_KEY_S]);
-        window->callbacks[GLFW_KEY_S]();
+        perror("Error setting up frame capture");
+        return;
     }
-    if (glfwGetKey(window->window, GLFW_KEY_D) == GLFW_PRESS)
+    frame_capture_request(&window->capture, path);
+}
+
+void render_window_swap(RenderWindow* window)
+{
+    if (window->dump_path)
     {
-        assert(window->callbacks[GLFW_KEY_D]);
-        window->callbacks[GLFW_KEY_D]();
+        if (strchr(window->dump_path, '%'))
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), window->dump_path, window->frame);
+            render_window_capture_frame(window, path);
+        }
+        else if (window->frame + 1 == window->frame_limit)
+        {
+            render_window_capture_frame(window, window->dump_path);
+        }
+        frame_capture_poll(&window->capture, false);
     }
-    if ( glfwGetMouseButton(window->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    ++window->frame;
+
+    if (window->headless)
     {
-        if(!mouse_dragging) {
-            glfwGetCursorPos(window->window, &mouse_dragging_x, &mouse_dragging_y);
-            printf("mouse_dragging_x,y = %f, %f", mouse_dragging_x, mouse_dragging_y);
-        }
-        mouse_dragging = true;
+        // stands in for the throttling a real swap chain does, so frame times include rendering
+        glFinish();
+        return;
     }
+    glfwSwapBuffers(window->window);
+}
 
-    if ( glfwGetMouseButton(window->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
+void render_window_set_swap_interval(RenderWindow* window, int interval)
+{
+    // a headless context never waits for a display
+    if (!window->headless)
+        glfwSwapInterval(interval);
+}
+
+/* In Hz, 0 when unknown or headless. */
+int render_window_get_refresh_rate(RenderWindow* window)
+{
+    if (window->headless)
+        return 0;
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    return mode ? mode->refreshRate : 0;
+}
+
+void render_window_terminate(RenderWindow* window)
+{
+    if (window->capture.running)
+        frame_capture_shutdown(&window->capture);
+    if (!window->headless)
+    {
+        glfwTerminate();
+        return;
+    }
+    glDeleteFramebuffers(1, &window->framebuffer);
+    glDeleteRenderbuffers(2, window->renderbuffers);
+    eglMakeCurrent(window->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(window->egl_display, window->egl_context);
+    eglTerminate(window->egl_display);
+}
+void render_window_process_input(RenderWindow *window)
+{
+    if (!window->headless)
+        glfwPollEvents();
+    uint64_t now = time_now_ns();
+    InputLog* log = window->input_log;
+    if (log && log->recording)
+    {
+        input_log_record(log, (uint32_t) window->frame, &window->input_queue);
+    }
+    else if (log)
     {
-        mouse_dragging = false;
-        mouse_dragging_x = 0.0f;
-        mouse_dragging_y = 0.0f;
+        // a replay owns the input, live events are dropped
+        window->input_queue.head = window->input_queue.tail;
+        input_log_replay(log, (uint32_t) window->frame, &window->input_queue, now);
     }
-    
+    input_dispatch(&window->input_queue, &window->input_map, now);
 }
-void render_window_add_callback(RenderWindow *window, int key, void(*cb)(void))
+
+void render_window_request_close(RenderWindow *window)
 {
-    assert(key < CALLBACK_CAPACITY);
-    window->callbacks[key] = cb;
+    window->close_requested = true;
 }
 
 bool render_window_should_close(RenderWindow *window)
 {
-    return glfwWindowShouldClose(window->window);
+    if (window->close_requested || (window->frame_limit && window->frame >= window->frame_limit))
+        return true;
+    return !window->headless && glfwWindowShouldClose(window->window);
 }
 
 void render_window_get_mouse_pos(RenderWindow *window, double *x, double *y)
 {
-    glfwGetCursorPos(window->window, x, y);
+    *x = window->input_map.cursor_x;
+    *y = window->input_map.cursor_y;
 }
 
 bool render_window_get_mouse_dragging(RenderWindow *window)
 {
-    return mouse_dragging;
+    return window->input_map.buttons_down & (1u << GLFW_MOUSE_BUTTON_LEFT);
 }
 
 void render_window_get_window_size(RenderWindow *window, int *width, int *height)
 {
+    if (window->headless)
+    {
+        *width = window->width;
+        *height = window->height;
+        return;
+    }
     glfwGetWindowSize(window->window, width, height);
 }
 static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -1,19 +1,51 @@
 #ifndef RENDER_WINDOW_H
 #define RENDER_WINDOW_H
 #include <stdbool.h>
+#include <stdint.h>
 #include <GLFW/glfw3.h>
 
-#define CALLBACK_CAPACITY GLFW_KEY_LAST
+#include "frame_capture.h"
+#include "input.h"
+#include "input_log.h"
 
+/* Headless windows have no GLFW window. They render into an offscreen
+ * framebuffer on an EGL surfaceless context and close themselves after
+ * frame_limit frames (0 runs until killed). */
 typedef struct RenderWindow
 {
     GLFWwindow* window;
-    void(*callbacks[CALLBACK_CAPACITY])(void);
+    InputQueue input_queue; // filled by the GLFW callbacks
+    InputMap input_map;
+    InputLog* input_log; // records what is dispatched, or replaces device input when replaying
+    bool close_requested;
+
+    bool headless;
+    void* egl_display;
+    void* egl_context;
+    unsigned int framebuffer;
+    unsigned int renderbuffers[2]; // colour, depth
+    int width;
+    int height;
+    int frame;
+    int frame_limit;
+    const char* dump_path; // printf pattern with %d dumps every frame, otherwise only the last
+    FrameCapture capture;  // set up by the first dump
+    uint64_t gl_load_ns;   // resolving GL entry points once the context is current
 }RenderWindow;
 
 void render_window_init(RenderWindow* window, int width, int height, const char* title);
+void render_window_init_headless(RenderWindow* window, int width, int height, int frame_limit);
+void render_window_swap(RenderWindow* window);
+void render_window_set_swap_interval(RenderWindow* window, int interval);
+int render_window_get_refresh_rate(RenderWindow* window);
+/* Queues an asynchronous readback of the frame about to be presented, the
+ * file is written a few frames later or at terminate. */
+void render_window_capture_frame(RenderWindow* window, const char* path);
+void render_window_terminate(RenderWindow* window);
+/* Polls the window system and dispatches everything queued since the last
+ * call through input_map. */
 void render_window_process_input(RenderWindow *window);
-void render_window_add_callback(RenderWindow *window, int key, void(*cb)(void));
+void render_window_request_close(RenderWindow *window);
 bool render_window_should_close(RenderWindow *window);
 void render_window_get_mouse_pos(RenderWindow *window, double *x, double *y);
 bool render_window_get_mouse_dragging(RenderWindow *window);
@@ -0,0 +1,166 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets.h"
+#include "shader_variant.h"
+
+static bool append(ShaderText* text, const char* data, size_t size)
+{
+    if (text->size + size + 1 > text->capacity)
+    {
+        size_t capacity = text->capacity ? text->capacity : 4096;
+        while (text->size + size + 1 > capacity)
+            capacity *= 2;
+        char* grown = realloc(text->data, capacity);
+        if (!grown)
+        {
+            perror("Error allocating shader text");
+            return false;
+        }
+        text->data = grown;
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->size, data, size);
+    text->size += size;
+    text->data[text->size] = '\0';
+    return true;
+}
+
+static bool appendf(ShaderText* text, const char* format, ...)
+{
+    char line[SHADER_PATH_MAX];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return length >= 0 && (size_t) length < sizeof(line) && append(text, line, (size_t) length);
+}
+
+// #include "name" with any blanks around the tokens, the name is copied out
+static bool parse_include(const char* line, const char* end, char* name, size_t size)
+{
+    const char* c = line;
+    while (c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    if (c == end || *c++ != '#')
+        return false;
+    while (c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    if ((size_t) (end - c) < 7 || strncmp(c, "include", 7) != 0)
+        return false;
+    c += 7;
+    while (c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    if (c == end || *c++ != '"')
+        return false;
+    const char* close = memchr(c, '"', end - c);
+    if (!close || (size_t) (close - c) >= size)
+        return false;
+    memcpy(name, c, close - c);
+    name[close - c] = '\0';
+    return true;
+}
+
+static bool resolve_path(const char* including, const char* name, char* path, size_t size)
+{
+    const char* slash = strrchr(including, '/');
+    int length;
+    if (name[0] == '/' || !slash)
+        length = snprintf(path, size, "%s", name);
+    else
+        length = snprintf(path, size, "%.*s/%s", (int) (slash - including), including, name);
+    return length >= 0 && (size_t) length < size;
+}
+
+static bool include_file(ShaderText* text, const char* path, int depth)
+{
+    if (depth > SHADER_MAX_INCLUDE_DEPTH || text->file_count == SHADER_MAX_FILES)
+    {
+        printf("Error preprocessing shader: too many includes at %s\n", path);
+        return false;
+    }
+    int source = text->file_count++;
+    snprintf(text->files[source], SHADER_PATH_MAX, "%s", path);
+
+    Asset asset;
+    if (!asset_open(path, &asset))
+    {
+        printf("Error reading shader %s\n", path);
+        return false;
+    }
+
+    const char* line = asset.data;
+    const char* end = asset.data + asset.size;
+    int line_number = 1;
+    bool ok = true;
+    while (ok && line < end)
+    {
+        const char* eol = memchr(line, '\n', end - line);
+        const char* next = eol ? eol + 1 : end;
+        char name[SHADER_PATH_MAX];
+        if (parse_include(line, next, name, sizeof(name)))
+        {
+            char included[SHADER_PATH_MAX];
+            if (!resolve_path(path, name, included, sizeof(included)))
+            {
+                printf("Error preprocessing shader: include path too long at %s:%d\n", path, line_number);
+                ok = false;
+            }
+            else
+            {
+                ok = appendf(text, "#line 1 %d\n", text->file_count)
+                    && include_file(text, included, depth + 1)
+                    && appendf(text, "\n#line %d %d\n", line_number + 1, source);
+            }
+        }
+        else
+        {
+            ok = append(text, line, next - line);
+        }
+        line = next;
+        line_number++;
+    }
+    asset_close(&asset);
+    return ok;
+}
+
+bool shader_preprocess(const char* path, ShaderText* text)
+{
+    *text = (ShaderText) {0};
+    if (!include_file(text, path, 0))
+    {
+        shader_text_free(text);
+        return false;
+    }
+    return true;
+}
+
+void shader_text_free(ShaderText* text)
+{
+    free(text->data);
+    *text = (ShaderText) {0};
+}
+
+void shader_variant_init(ShaderVariant* variant, const char* base_name, const ShaderPermutation* permutation,
+                         const ShaderText* vertex, const ShaderText* fragment)
+{
+    variant->permutation = *permutation;
+    if (variant->permutation.model_count < 1)
+        variant->permutation.model_count = 1;
+    const ShaderPermutation* p = &variant->permutation;
+    snprintf(variant->name, sizeof(variant->name), "%s_m%d_c%d_t%d", base_name, p->model_count, p->use_color,
+             (int) p->texture_format);
+    snprintf(variant->defines, sizeof(variant->defines),
+             "#define MODEL_COUNT %d\n#define USE_COLOR %d\n#define TEXTURE_FORMAT %d\n", p->model_count,
+             p->use_color, (int) p->texture_format);
+    variant->source = (ProgramSource) {
+        .name = variant->name,
+        .vertex = vertex->data,
+        .vertex_size = vertex->size,
+        .fragment = fragment->data,
+        .fragment_size = fragment->size,
+        .defines = variant->defines,
+    };
+}
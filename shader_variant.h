@@ -0,0 +1,64 @@
+#ifndef SHADER_VARIANT_H
+#define SHADER_VARIANT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "program_cache.h"
+
+#define SHADER_MAX_FILES 16        // a file and everything it includes
+#define SHADER_MAX_INCLUDE_DEPTH 8
+#define SHADER_PATH_MAX 256
+#define SHADER_DEFINES_MAX 256
+#define SHADER_NAME_MAX 64
+
+/* Matches the TEXTURE_* values in common.glsl. */
+typedef enum ShaderTextureFormat
+{
+    SHADER_TEXTURE_NONE,    // no texture at all, vertex colour or white
+    SHADER_TEXTURE_PLAIN,   // texture1 by uv
+    SHADER_TEXTURE_VIRTUAL, // vt_cache through vt_indirection
+    SHADER_TEXTURE_PACKED,  // gray maps in the channels of texture1
+    SHADER_TEXTURE_CUBE,    // cube_map by model space direction
+}ShaderTextureFormat;
+
+/* Everything a variant is specialised on. Each field turns into a #define,
+ * so the driver sees constants where the old shader read uniforms. */
+typedef struct ShaderPermutation
+{
+    int model_count; // matrices multiplied per vertex, 0 means 1
+    bool use_color;  // modulate by the vertex colour
+    ShaderTextureFormat texture_format;
+}ShaderPermutation;
+
+/* A shader file with its #include "file" lines replaced by the files'
+ * contents, paths relative to the including file. Included text is framed
+ * by #line directives whose source number is the index into files, so a
+ * compile error names the file as well as the line. */
+typedef struct ShaderText
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+    int file_count;
+    char files[SHADER_MAX_FILES][SHADER_PATH_MAX];
+}ShaderText;
+
+/* One specialisation of a vertex/fragment pair, ready for the program
+ * cache. The name carries the permutation so variants get their own cache
+ * files. source points into the texts and the defines here. */
+typedef struct ShaderVariant
+{
+    ShaderPermutation permutation;
+    char name[SHADER_NAME_MAX];
+    char defines[SHADER_DEFINES_MAX];
+    ProgramSource source;
+}ShaderVariant;
+
+bool shader_preprocess(const char* path, ShaderText* text);
+void shader_text_free(ShaderText* text);
+
+void shader_variant_init(ShaderVariant* variant, const char* base_name, const ShaderPermutation* permutation,
+                         const ShaderText* vertex, const ShaderText* fragment);
+
+#endif // SHADER_VARIANT_H
@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "profiler.h"
+#include "simulation.h"
+#include "util.h"
+
+static void step(SimState* state, SimInput* input, float dt)
+{
+    state->camera_position.x += input->move.x * SIMULATION_MOVE_SPEED * dt;
+    state->camera_position.y += input->move.y * SIMULATION_MOVE_SPEED * dt;
+    state->camera_position.z += input->move.z * SIMULATION_MOVE_SPEED * dt;
+    state->spin += SIMULATION_SPIN_SPEED * dt;
+    // a drag is a distance, not a rate, so it lands whole on one step
+    state->x_rot += input->drag_x;
+    state->y_rot += input->drag_y;
+    input->drag_x = 0.0f;
+    input->drag_y = 0.0f;
+}
+
+static void blend(const SimState* a, const SimState* b, float t, SimState* out)
+{
+    out->camera_position.x = a->camera_position.x + t * (b->camera_position.x - a->camera_position.x);
+    out->camera_position.y = a->camera_position.y + t * (b->camera_position.y - a->camera_position.y);
+    out->camera_position.z = a->camera_position.z + t * (b->camera_position.z - a->camera_position.z);
+    out->x_rot = a->x_rot + t * (b->x_rot - a->x_rot);
+    out->y_rot = a->y_rot + t * (b->y_rot - a->y_rot);
+    out->spin = a->spin + t * (b->spin - a->spin);
+}
+
+static void* simulation_thread(void* arg)
+{
+    Simulation* sim = arg;
+    profiler_set_thread_name("simulation");
+    float dt = sim->step_ns / 1e9f;
+    uint64_t next = time_now_ns();
+    while (atomic_load(&sim->running))
+    {
+        next += sim->step_ns;
+        struct timespec ts = {.tv_sec = next / 1000000000ull, .tv_nsec = next % 1000000000ull};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        // after a stall skip ahead instead of running a burst of steps
+        uint64_t now = time_now_ns();
+        if (now > next + SIMULATION_MAX_CATCH_UP_NS)
+            next = now;
+
+        profiler_begin("simulation step");
+        pthread_mutex_lock(&sim->lock);
+        SimInput input = sim->input;
+        sim->input.drag_x = 0.0f;
+        sim->input.drag_y = 0.0f;
+        SimState state = sim->current;
+        pthread_mutex_unlock(&sim->lock);
+
+        step(&state, &input, dt);
+
+        pthread_mutex_lock(&sim->lock);
+        sim->previous = sim->current;
+        sim->current = state;
+        sim->current_ns = next;
+        sim->steps++;
+        pthread_mutex_unlock(&sim->lock);
+        profiler_end();
+    }
+    return NULL;
+}
+
+bool simulation_init(Simulation* sim, double hz, const SimState* initial, bool threaded)
+{
+    *sim = (Simulation) {
+        .step_ns = (uint64_t) (1e9 / hz),
+        .threaded = threaded,
+        .previous = *initial,
+        .current = *initial,
+        .current_ns = time_now_ns(),
+    };
+    sim->last_ns = sim->current_ns;
+    pthread_mutex_init(&sim->lock, NULL);
+    if (!threaded)
+        return true;
+
+    atomic_store(&sim->running, true);
+    if (pthread_create(&sim->thread, NULL, simulation_thread, sim) != 0)
+    {
+        perror("Error starting simulation thread");
+        sim->threaded = false;
+        atomic_store(&sim->running, false);
+        return false;
+    }
+    return true;
+}
+
+void simulation_set_input(Simulation* sim, const SimInput* input)
+{
+    pthread_mutex_lock(&sim->lock);
+    sim->input.move = input->move;
+    sim->input.drag_x += input->drag_x;
+    sim->input.drag_y += input->drag_y;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void simulation_advance(Simulation* sim, uint64_t now_ns)
+{
+    if (sim->threaded)
+        return;
+    // the render worker may advance while the main thread hands over input
+    pthread_mutex_lock(&sim->lock);
+    sim->accumulator_ns += now_ns > sim->last_ns ? now_ns - sim->last_ns : 0;
+    sim->last_ns = now_ns;
+    if (sim->accumulator_ns > SIMULATION_MAX_CATCH_UP_NS)
+        sim->accumulator_ns = SIMULATION_MAX_CATCH_UP_NS;
+
+    float dt = sim->step_ns / 1e9f;
+    while (sim->accumulator_ns >= sim->step_ns)
+    {
+        sim->previous = sim->current;
+        step(&sim->current, &sim->input, dt);
+        sim->accumulator_ns -= sim->step_ns;
+        sim->steps++;
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void simulation_get_state(Simulation* sim, uint64_t now_ns, SimState* state)
+{
+    pthread_mutex_lock(&sim->lock);
+    if (!sim->threaded)
+    {
+        blend(&sim->previous, &sim->current, (float) sim->accumulator_ns / sim->step_ns, state);
+        pthread_mutex_unlock(&sim->lock);
+        return;
+    }
+    float t = now_ns > sim->current_ns ? (float) (now_ns - sim->current_ns) / sim->step_ns : 0.0f;
+    blend(&sim->previous, &sim->current, t < 1.0f ? t : 1.0f, state);
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void simulation_shutdown(Simulation* sim)
+{
+    if (sim->threaded)
+    {
+        atomic_store(&sim->running, false);
+        pthread_join(sim->thread, NULL);
+    }
+    pthread_mutex_destroy(&sim->lock);
+}
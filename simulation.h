@@ -0,0 +1,64 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "geom.h"
+
+#define SIMULATION_DEFAULT_HZ 120.0
+#define SIMULATION_MOVE_SPEED 0.6f     // units per second, what 0.01 per frame was at 60 fps
+#define SIMULATION_SPIN_SPEED 0.6f     // radians per second the moons turn, likewise
+#define SIMULATION_MAX_CATCH_UP_NS 250000000ull // drop time rather than spiral after a stall
+
+typedef struct SimState
+{
+    Vec3 camera_position;
+    float x_rot;
+    float y_rot;
+    float spin;
+}SimState;
+
+/* Input for the next steps. move is a direction held this frame, drag is
+ * the rotation the mouse asked for since the last step consumed it. */
+typedef struct SimInput
+{
+    Vec3 move;
+    float drag_x;
+    float drag_y;
+}SimInput;
+
+/* Fixed timestep simulation. Rendering asks for the state at a point in
+ * time and gets previous and current blended, so the render and simulation
+ * rates are independent. Single threaded, simulation_advance runs the steps
+ * that are due from an accumulator. Threaded, a simulation thread steps on
+ * its own clock while the main thread renders, and rendering runs one step
+ * behind it so there is always a pair to blend. */
+typedef struct Simulation
+{
+    uint64_t step_ns;
+    bool threaded;
+
+    SimInput input;
+    SimState previous;
+    SimState current;
+    uint64_t current_ns; // when current became valid
+    uint64_t accumulator_ns;
+    uint64_t last_ns;
+    uint64_t steps;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    atomic_bool running;
+}Simulation;
+
+bool simulation_init(Simulation* sim, double hz, const SimState* initial, bool threaded);
+/* Replaces the held direction and adds to the pending drag. */
+void simulation_set_input(Simulation* sim, const SimInput* input);
+void simulation_advance(Simulation* sim, uint64_t now_ns);
+void simulation_get_state(Simulation* sim, uint64_t now_ns, SimState* state);
+void simulation_shutdown(Simulation* sim);
+
+#endif // SIMULATION_H
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets.h"
+#include "decode_pool.h"
+#include "pixel_convert.h"
+#include "texture_pack.h"
+
+static int channel_index(char name)
+{
+    const char* names = "rgba";
+    const char* found = strchr(names, name);
+    return name && found ? (int) (found - names) : -1;
+}
+
+bool pack_manifest_load(PackManifest* manifest, const char* path)
+{
+    *manifest = (PackManifest) {.grid_x = 1, .grid_y = 1};
+    Asset asset;
+    FILE* file = NULL;
+    if (!asset_open(path, &asset) || !(file = fmemopen((void*) asset.data, asset.size, "r")))
+    {
+        perror("Error opening texture pack manifest");
+        if (asset.data)
+            asset_close(&asset);
+        return false;
+    }
+
+    char line[512];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+        // whitespace only lines, CRLF ones included, leave sscanf nothing to read
+        char* text = line + strspn(line, " \t\r\n");
+        if (*text == '#' || *text == '\0')
+            continue;
+
+        char name[16], source[TEXTURE_PACK_PATH_MAX];
+        int a = 0, b = 0;
+        int fields = sscanf(text, "%15s %255s %d %d", name, source, &a, &b);
+        if (strcmp(name, "grid") == 0)
+        {
+            fields = sscanf(text, "grid %d %d", &a, &b);
+            ok = fields == 2 && a >= 1 && b >= 1 && a <= TEXTURE_PACK_MAX_GRID && b <= TEXTURE_PACK_MAX_GRID;
+            manifest->grid_x = a;
+            manifest->grid_y = b;
+            continue;
+        }
+        int channel = strlen(name) == 1 ? channel_index(name[0]) : -1;
+        ok = channel >= 0 && (fields == 2 || fields == 4) && !manifest->channels[channel].path[0];
+        if (!ok)
+            break;
+        PackChannel* c = &manifest->channels[channel];
+        snprintf(c->path, sizeof(c->path), "%s", source);
+        c->tile_x = a;
+        c->tile_y = b;
+        manifest->channel_count++;
+    }
+    fclose(file);
+    asset_close(&asset);
+    if (!ok)
+    {
+        printf("%s:%d: expected 'grid X Y' or 'r|g|b|a image [tile_x tile_y]', each channel once\n", path, line_number);
+        return false;
+    }
+    for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+    {
+        const PackChannel* c = &manifest->channels[i];
+        if (c->path[0] && (c->tile_x < 0 || c->tile_y < 0 || c->tile_x >= manifest->grid_x || c->tile_y >= manifest->grid_y))
+        {
+            printf("%s: tile %d %d of %s is outside the %dx%d grid\n", path, c->tile_x, c->tile_y, c->path,
+                   manifest->grid_x, manifest->grid_y);
+            return false;
+        }
+    }
+    if (manifest->channel_count == 0)
+    {
+        printf("%s: no channels\n", path);
+        return false;
+    }
+    return true;
+}
+
+/* Decodes every map of the manifest as gray into results, indexed by
+ * channel, and checks they share one size. The caller releases the results
+ * and shuts the pool down either way. */
+static bool decode_maps(DecodePool* pool, const PackManifest* manifest, DecodeResult results[TEXTURE_PACK_CHANNELS],
+                        int* width, int* height)
+{
+    for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+    {
+        if (manifest->channels[i].path[0])
+            decode_pool_submit_file(pool, manifest->channels[i].path, 1, i);
+    }
+
+    *width = *height = 0;
+    DecodeResult result;
+    bool ok = true;
+    while (decode_pool_next(pool, &result, true))
+    {
+        results[result.tag] = result;
+        ok = ok && result.ok;
+        if (!result.ok)
+            continue;
+        if (*width && (result.width != *width || result.height != *height))
+        {
+            printf("%s is %dx%d, the other maps are %dx%d\n", manifest->channels[result.tag].path,
+                   result.width, result.height, *width, *height);
+            ok = false;
+        }
+        *width = result.width;
+        *height = result.height;
+    }
+    return ok;
+}
+
+bool texture_pack_build(PackedTexture* packed, const PackManifest* manifest)
+{
+    *packed = (PackedTexture) {.manifest = *manifest};
+    // all maps are held together until the pack is assembled, so they decode without a budget
+    DecodePool pool;
+    if (!decode_pool_init(&pool, manifest->channel_count, 0))
+        return false;
+    DecodeResult results[TEXTURE_PACK_CHANNELS] = {0};
+    bool ok = decode_maps(&pool, manifest, results, &packed->width, &packed->height);
+
+    size_t pixel_count = (size_t) packed->width * packed->height;
+    if (ok)
+    {
+        packed->pixels = malloc(pixel_count * 4);
+        ok = packed->pixels != NULL;
+    }
+    if (ok)
+    {
+        const uint8_t* planes[TEXTURE_PACK_CHANNELS] = {0};
+        for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+            planes[i] = results[i].pixels;
+        pixel_interleave4(planes, 0, packed->pixels, pixel_count);
+        packed->separate_bytes = pixel_count * manifest->channel_count;
+    }
+    for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+        decode_pool_release(&pool, &results[i]);
+    decode_pool_shutdown(&pool);
+    if (!ok)
+        texture_pack_free(packed);
+    return ok;
+}
+
+uint8_t* texture_pack_mosaic(const PackManifest* manifest, int* width, int* height)
+{
+    const PackChannel* cells[TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID] = {0};
+    for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+    {
+        const PackChannel* c = &manifest->channels[i];
+        if (c->path[0] && !cells[c->tile_y * TEXTURE_PACK_MAX_GRID + c->tile_x])
+            cells[c->tile_y * TEXTURE_PACK_MAX_GRID + c->tile_x] = c;
+    }
+    for (int y = 0; y < manifest->grid_y; ++y)
+    {
+        for (int x = 0; x < manifest->grid_x; ++x)
+        {
+            if (!cells[y * TEXTURE_PACK_MAX_GRID + x])
+            {
+                printf("texture pack: no map covers tile %d %d of the %dx%d grid\n", x, y, manifest->grid_x, manifest->grid_y);
+                return NULL;
+            }
+        }
+    }
+
+    // as in texture_pack_build every tile is held until the mosaic is done
+    DecodePool pool;
+    if (!decode_pool_init(&pool, manifest->channel_count, 0))
+        return NULL;
+    DecodeResult results[TEXTURE_PACK_CHANNELS] = {0};
+    int tile_width, tile_height;
+    bool ok = decode_maps(&pool, manifest, results, &tile_width, &tile_height);
+    *width = tile_width * manifest->grid_x;
+    *height = tile_height * manifest->grid_y;
+    uint8_t* pixels = ok ? malloc((size_t) *width * *height) : NULL;
+    for (int y = 0; pixels && y < manifest->grid_y; ++y)
+    {
+        for (int x = 0; x < manifest->grid_x; ++x)
+        {
+            const uint8_t* tile = results[cells[y * TEXTURE_PACK_MAX_GRID + x] - manifest->channels].pixels;
+            for (int row = 0; row < tile_height; ++row)
+            {
+                memcpy(pixels + ((size_t) y * tile_height + row) * *width + (size_t) x * tile_width,
+                       tile + (size_t) row * tile_width, tile_width);
+            }
+        }
+    }
+    for (int i = 0; i < TEXTURE_PACK_CHANNELS; ++i)
+        decode_pool_release(&pool, &results[i]);
+    decode_pool_shutdown(&pool);
+    return pixels;
+}
+
+void texture_pack_tile_masks(const PackManifest* manifest, float masks[TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID][4])
+{
+    memset(masks, 0, sizeof(float) * TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID * 4);
+    // the first channel placed in a cell is the one shown there
+    for (int i = TEXTURE_PACK_CHANNELS - 1; i >= 0; --i)
+    {
+        const PackChannel* c = &manifest->channels[i];
+        if (!c->path[0])
+            continue;
+        float* mask = masks[c->tile_y * TEXTURE_PACK_MAX_GRID + c->tile_x];
+        memset(mask, 0, sizeof(float) * 4);
+        mask[i] = 1.0f;
+    }
+}
+
+void texture_pack_free(PackedTexture* packed)
+{
+    free(packed->pixels);
+    packed->pixels = NULL;
+}
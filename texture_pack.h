@@ -0,0 +1,57 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TEXTURE_PACK_CHANNELS 4
+#define TEXTURE_PACK_MAX_GRID 2
+#define TEXTURE_PACK_PATH_MAX 256
+
+typedef struct PackChannel
+{
+    char path[TEXTURE_PACK_PATH_MAX]; // empty when the channel is unused
+    int tile_x;
+    int tile_y;
+}PackChannel;
+
+/* Which gray map goes into which channel. Maps either all cover the whole
+ * surface (grid 1 1) or are the tiles of one bigger map, in which case each
+ * channel says which cell of the grid it holds.
+ *
+ *     # comment
+ *     grid 2 2
+ *     r earth00.jpg 0 0
+ *     g earth01.jpg 1 0
+ */
+typedef struct PackManifest
+{
+    int grid_x;
+    int grid_y;
+    PackChannel channels[TEXTURE_PACK_CHANNELS];
+    int channel_count;
+}PackManifest;
+
+typedef struct PackedTexture
+{
+    int width;
+    int height;
+    uint8_t* pixels; // RGBA8
+    PackManifest manifest;
+    size_t separate_bytes; // what the maps take as one R8 texture each
+}PackedTexture;
+
+bool pack_manifest_load(PackManifest* manifest, const char* path);
+/* Decodes every map in the manifest as gray and interleaves them. All maps
+ * must share one size, unused channels are filled with zero. */
+bool texture_pack_build(PackedTexture* packed, const PackManifest* manifest);
+/* The maps laid out on their grid as one gray image, the whole surface the
+ * tiles cover, width * height bytes to free(). Every cell needs a map, the
+ * first channel placed in a cell is the one used. NULL on failure. */
+uint8_t* texture_pack_mosaic(const PackManifest* manifest, int* width, int* height);
+/* Channel mask per grid cell, for a dot product in the shader. */
+void texture_pack_tile_masks(const PackManifest* manifest, float masks[TEXTURE_PACK_MAX_GRID * TEXTURE_PACK_MAX_GRID][4]);
+void texture_pack_free(PackedTexture* packed);
+
+#endif // TEXTURE_PACK_H
@@ -0,0 +1,42 @@
+// Samplers and lookups of each TEXTURE_FORMAT, only the one in use is declared.
+#if TEXTURE_FORMAT == TEXTURE_PLAIN || TEXTURE_FORMAT == TEXTURE_PACKED
+uniform sampler2D texture1;
+#endif
+
+#if TEXTURE_FORMAT == TEXTURE_VIRTUAL
+uniform sampler2D vt_cache;
+uniform sampler2D vt_indirection;
+uniform vec2 vt_size;        // level 0 size in texels
+uniform vec3 vt_page;        // payload, page size, border in texels
+uniform float vt_cache_size; // cache texture size in texels
+
+vec4 sample_virtual(vec2 uv)
+{
+    vec2 texel0 = clamp(uv * vt_size, vec2(0.0), vt_size - 0.5);
+    vec4 entry = floor(texelFetch(vt_indirection, ivec2(texel0 / vt_page.x), 0) * 255.0 + 0.5);
+    vec2 texel = texel0 / exp2(entry.b);
+    vec2 in_page = texel - floor(texel / vt_page.x) * vt_page.x;
+    vec2 cache_texel = entry.rg * vt_page.y + vt_page.z + in_page;
+    return texture(vt_cache, cache_texel / vt_cache_size);
+}
+#endif
+
+#if TEXTURE_FORMAT == TEXTURE_PACKED
+uniform vec2 pack_grid;      // texture1 holds up to four gray maps, tiles of one surface on this grid
+uniform vec4 pack_masks[4];  // channel of each grid cell, row major in a 2x2 grid
+uniform vec4 pack_rect;      // offset and size of the part of the whole surface the mesh uv covers
+
+vec4 sample_packed(vec2 uv)
+{
+    vec2 grid_uv = (pack_rect.xy + uv * pack_rect.zw) * pack_grid;
+    vec2 tile = min(floor(grid_uv), pack_grid - 1.0);
+    // gradients of the continuous coordinate, fract() would jump at tile edges and pick the smallest mip
+    vec4 texel = textureGrad(texture1, grid_uv - tile, dFdx(grid_uv), dFdy(grid_uv));
+    float value = dot(texel, pack_masks[int(tile.y) * 2 + int(tile.x)]);
+    return vec4(value, 0.0, 0.0, 1.0);
+}
+#endif
+
+#if TEXTURE_FORMAT == TEXTURE_CUBE
+uniform samplerCube cube_map;
+#endif
@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "glad/glad.h"
+#include "stb_image.h"
+#include "mesh_cache.h"
+#include "pixel_convert.h"
+#include "profiler.h"
+#include "texture_stream.h"
+
+static const GLenum channel_formats[] = {0, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+static uint64_t align_level(uint64_t offset)
+{
+    return (offset + TEXTURE_STREAM_ALIGN - 1) & ~(uint64_t) (TEXTURE_STREAM_ALIGN - 1);
+}
+
+static int level_width(const MipCacheHeader* header, int level)
+{
+    int width = (int) header->width >> level;
+    return width > 0 ? width : 1;
+}
+
+static int level_height(const MipCacheHeader* header, int level)
+{
+    int height = (int) header->height >> level;
+    return height > 0 ? height : 1;
+}
+
+static size_t row_bytes(const MipCacheHeader* header, int level)
+{
+    return (size_t) level_width(header, level) * header->channels;
+}
+
+/* Decodes the image and writes every level the way load_texture would
+ * upload it, same filter and conversion, so a streamed texture ends up
+ * identical to one loaded in one go. */
+static bool bake_cache(const char* image_path, const char* cache_path)
+{
+    struct stat st;
+    FileSpan source;
+    if (stat(image_path, &st) != 0 || !map_file(image_path, &source, FILE_ACCESS_SEQUENTIAL))
+    {
+        perror("Error reading texture");
+        return false;
+    }
+    int width, height, channels;
+    profiler_begin("decode");
+    uint8_t* image = stbi_load_from_memory((const stbi_uc*) source.data, (int) source.size, &width, &height, &channels, 0);
+    profiler_end();
+    unmap_file(&source);
+    if (!image)
+    {
+        fprintf(stderr, "Failed to decode %s\n", image_path);
+        return false;
+    }
+
+    MipChain chain = {0};
+    MipOptions mip_options = {.filter = MIP_FILTER_KAISER, .color_space = MIP_COLOR_LINEAR};
+    PixelConversion conversion = pixel_conversion_make(channels, 0);
+    profiler_begin("build mips");
+    bool ok = mip_chain_build(&chain, image, width, height, channels, &mip_options);
+    profiler_end();
+
+    MipCacheHeader header = {
+        .magic = TEXTURE_STREAM_MAGIC,
+        .version = TEXTURE_STREAM_VERSION,
+        .width = width,
+        .height = height,
+        .channels = conversion.dst_channels,
+        .level_count = chain.level_count,
+        .source_size = st.st_size,
+        .source_mtime = st.st_mtime,
+    };
+    uint64_t offset = align_level(sizeof(header));
+    for (int level = 0; level < chain.level_count; ++level)
+    {
+        header.level_offsets[level] = offset;
+        offset = align_level(offset + (uint64_t) chain.levels[level].width * chain.levels[level].height * header.channels);
+    }
+
+    char tmp_path[TEXTURE_STREAM_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+    FILE* file = ok ? fopen(tmp_path, "wb") : NULL;
+    if (ok && !file)
+    {
+        perror("Error writing mip cache");
+        ok = false;
+    }
+    uint8_t* converted = ok ? malloc((size_t) width * height * header.channels) : NULL;
+    ok = ok && converted && fwrite(&header, sizeof(header), 1, file) == 1;
+    static const uint8_t zeros[TEXTURE_STREAM_ALIGN] = {0};
+    uint64_t written = sizeof(header);
+    for (int level = 0; ok && level < chain.level_count; ++level)
+    {
+        const MipLevel* mip = &chain.levels[level];
+        size_t bytes = (size_t) mip->width * mip->height * header.channels;
+        pixel_convert(&conversion, mip->data, converted, (size_t) mip->width * mip->height);
+        ok = fwrite(zeros, 1, header.level_offsets[level] - written, file) == header.level_offsets[level] - written
+            && fwrite(converted, 1, bytes, file) == bytes;
+        written = header.level_offsets[level] + bytes;
+    }
+    free(converted);
+    if (chain.level_count)
+        mip_chain_free(&chain);
+    stbi_image_free(image);
+
+    if (file)
+        ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, cache_path) != 0)
+    {
+        perror("Error writing mip cache");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+static bool open_cache(TextureStream* stream)
+{
+    struct stat source, cache;
+    if (stat(stream->image_path, &source) != 0)
+        return false;
+    // no cache yet is the normal first run and rebake, only other failures are worth reporting
+    if (stat(stream->cache_path, &cache) != 0)
+    {
+        if (errno != ENOENT)
+            perror("Error reading texture cache");
+        return false;
+    }
+    if (!map_file(stream->cache_path, &stream->file, FILE_ACCESS_SEQUENTIAL))
+        return false;
+    const MipCacheHeader* header = (const MipCacheHeader*) stream->file.data;
+    bool ok = stream->file.size >= sizeof(MipCacheHeader)
+        && header->magic == TEXTURE_STREAM_MAGIC
+        && header->version == TEXTURE_STREAM_VERSION
+        && header->channels >= 1 && header->channels <= 4
+        && header->level_count >= 1 && header->level_count <= MIP_MAX_LEVELS
+        && header->source_size == (uint64_t) source.st_size
+        && header->source_mtime == source.st_mtime;
+    int last = ok ? (int) header->level_count - 1 : 0;
+    ok = ok && header->level_offsets[last] + row_bytes(header, last) * level_height(header, last) <= stream->file.size;
+    if (!ok)
+    {
+        unmap_file(&stream->file);
+        return false;
+    }
+    stream->header = header;
+    return true;
+}
+
+static void* bake_thread(void* arg)
+{
+    TextureStream* stream = arg;
+    profiler_set_thread_name("texture baker");
+    bool ok = bake_cache(stream->image_path, stream->cache_path);
+    pthread_mutex_lock(&stream->lock);
+    stream->bake_result = ok ? 1 : -1;
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+static void upload_rows(const TextureStream* stream, int level, int first_row, int rows)
+{
+    const MipCacheHeader* header = stream->header;
+    GLenum format = channel_formats[header->channels];
+    const uint8_t* data = (const uint8_t*) stream->file.data + header->level_offsets[level] + first_row * row_bytes(header, level);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, first_row, level_width(header, level), rows, format, GL_UNSIGNED_BYTE, data);
+}
+
+// allocates a level's storage, its rows arrive later
+static void define_level(const TextureStream* stream, int level)
+{
+    GLenum format = channel_formats[stream->header->channels];
+    glTexImage2D(GL_TEXTURE_2D, level, format, level_width(stream->header, level), level_height(stream->header, level),
+                 0, format, GL_UNSIGNED_BYTE, NULL);
+}
+
+/* Uploads every level no bigger than the proxy size in one go and makes
+ * them the visible range. */
+static void upload_proxy(TextureStream* stream)
+{
+    const MipCacheHeader* header = stream->header;
+    int base = (int) header->level_count - 1;
+    while (base > 0 && level_width(header, base - 1) <= TEXTURE_STREAM_PROXY_SIZE
+           && level_height(header, base - 1) <= TEXTURE_STREAM_PROXY_SIZE)
+        --base;
+
+    glBindTexture(GL_TEXTURE_2D, stream->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = base; level < (int) header->level_count; ++level)
+    {
+        define_level(stream, level);
+        upload_rows(stream, level, 0, level_height(header, level));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+    if (base > 0)
+        define_level(stream, base - 1);
+
+    stream->base_level = base;
+    stream->uploaded_rows = 0;
+    stream->proxy_ns = time_now_ns();
+    stream->state = TEXTURE_STREAM_STREAMING;
+    printf("texture stream: %s proxy %dx%d after %.1fms\n", stream->image_path, level_width(header, base),
+           level_height(header, base), (stream->proxy_ns - stream->start_ns) / 1e6);
+}
+
+bool texture_stream_open(TextureStream* stream, const char* image_path)
+{
+    *stream = (TextureStream) {.start_ns = time_now_ns()};
+    snprintf(stream->image_path, sizeof(stream->image_path), "%s", image_path);
+    const char* name = strrchr(image_path, '/');
+    name = name ? name + 1 : image_path;
+    snprintf(stream->cache_path, sizeof(stream->cache_path), MESH_CACHE_DIR "/%s.mips", name);
+
+    glGenTextures(1, &stream->texture);
+    glBindTexture(GL_TEXTURE_2D, stream->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (open_cache(stream))
+    {
+        upload_proxy(stream);
+        return true;
+    }
+
+    // stb_image has no scaled decode, so without a cache there is nothing to show until the bake is done
+    static const uint8_t placeholder = 0;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, 1, 1, 0, GL_RED, GL_UNSIGNED_BYTE, &placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    if (mkdir(MESH_CACHE_DIR, 0755) != 0 && errno != EEXIST)
+    {
+        perror("Error creating cache directory");
+        stream->state = TEXTURE_STREAM_FAILED;
+        return false;
+    }
+    pthread_mutex_init(&stream->lock, NULL);
+    stream->state = TEXTURE_STREAM_BAKING;
+    if (pthread_create(&stream->baker, NULL, bake_thread, stream) != 0)
+    {
+        perror("Error starting texture baker");
+        pthread_mutex_destroy(&stream->lock);
+        stream->state = TEXTURE_STREAM_FAILED;
+        return false;
+    }
+    stream->baker_running = true;
+    return true;
+}
+
+static void join_baker(TextureStream* stream)
+{
+    pthread_join(stream->baker, NULL);
+    pthread_mutex_destroy(&stream->lock);
+    stream->baker_running = false;
+    if (stream->bake_result > 0 && open_cache(stream))
+    {
+        upload_proxy(stream);
+    }
+    else
+    {
+        printf("Failed to load texture %s\n", stream->image_path);
+        stream->state = TEXTURE_STREAM_FAILED;
+    }
+}
+
+void texture_stream_update(TextureStream* stream, size_t budget)
+{
+    if (stream->state == TEXTURE_STREAM_BAKING)
+    {
+        pthread_mutex_lock(&stream->lock);
+        int result = stream->bake_result;
+        pthread_mutex_unlock(&stream->lock);
+        if (result == 0)
+            return;
+        join_baker(stream);
+        return;
+    }
+    if (stream->state != TEXTURE_STREAM_STREAMING)
+        return;
+
+    const MipCacheHeader* header = stream->header;
+    glBindTexture(GL_TEXTURE_2D, stream->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    while (budget > 0 && stream->base_level > 0)
+    {
+        int level = stream->base_level - 1;
+        int height = level_height(header, level);
+        size_t bytes = row_bytes(header, level);
+        size_t remaining = (size_t) (height - stream->uploaded_rows);
+        size_t fit = budget / bytes;
+        int rows = (int) (fit < 1 ? 1 : fit > remaining ? remaining : fit);
+        upload_rows(stream, level, stream->uploaded_rows, rows);
+        stream->uploaded_rows += rows;
+        budget = budget > rows * bytes ? budget - rows * bytes : 0;
+        if (stream->uploaded_rows < height)
+            break;
+
+        // the whole level is in, let the sampler see it
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        stream->base_level = level;
+        stream->uploaded_rows = 0;
+        if (level > 0)
+            define_level(stream, level - 1);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (stream->base_level == 0)
+    {
+        stream->state = TEXTURE_STREAM_RESIDENT;
+        stream->resident_ns = time_now_ns();
+        unmap_file(&stream->file);
+        stream->header = NULL;
+        printf("texture stream: %s fully resident after %.1fms\n", stream->image_path,
+               (stream->resident_ns - stream->start_ns) / 1e6);
+    }
+}
+
+bool texture_stream_finish(TextureStream* stream)
+{
+    if (stream->state == TEXTURE_STREAM_BAKING)
+        join_baker(stream);
+    texture_stream_update(stream, SIZE_MAX);
+    return stream->state == TEXTURE_STREAM_RESIDENT;
+}
+
+void texture_stream_close(TextureStream* stream)
+{
+    if (stream->baker_running)
+    {
+        pthread_join(stream->baker, NULL);
+        pthread_mutex_destroy(&stream->lock);
+    }
+    if (stream->header)
+        unmap_file(&stream->file);
+    glDeleteTextures(1, &stream->texture);
+    *stream = (TextureStream) {0};
+}
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mipmap.h"
+#include "util.h"
+
+#define TEXTURE_STREAM_MAGIC 0x5350494d // "MIPS"
+#define TEXTURE_STREAM_VERSION 1
+#define TEXTURE_STREAM_ALIGN 4096
+#define TEXTURE_STREAM_PROXY_SIZE 256            // levels no bigger than this load before the first frame
+#define TEXTURE_STREAM_FRAME_BUDGET (4u << 20)   // bytes uploaded per frame after that
+#define TEXTURE_STREAM_PATH_MAX 512
+
+/* Cache file header. Levels follow at their offsets, already converted to
+ * the upload layout, so streaming is a straight copy out of the mapping. */
+typedef struct MipCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t level_count;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t level_offsets[MIP_MAX_LEVELS];
+}MipCacheHeader;
+
+typedef enum TextureStreamState
+{
+    TEXTURE_STREAM_BAKING,    // no cache yet, a worker decodes the image and writes one
+    TEXTURE_STREAM_STREAMING, // proxy levels resident, finer levels arriving
+    TEXTURE_STREAM_RESIDENT,
+    TEXTURE_STREAM_FAILED,
+}TextureStreamState;
+
+/* A mipmapped texture that is usable long before it is complete. Coarse
+ * levels come from the mip cache and are drawn right away, finer ones are
+ * uploaded a few rows per frame and only become visible, by lowering
+ * GL_TEXTURE_BASE_LEVEL, once a whole level is in. */
+typedef struct TextureStream
+{
+    char image_path[TEXTURE_STREAM_PATH_MAX];
+    char cache_path[TEXTURE_STREAM_PATH_MAX];
+    unsigned int texture;
+    TextureStreamState state;
+    FileSpan file;
+    const MipCacheHeader* header;
+
+    pthread_t baker;
+    pthread_mutex_t lock;
+    bool baker_running;
+    int bake_result; // 0 while running, then 1 or -1, under lock
+
+    int base_level;    // finest level complete on the GPU
+    int uploaded_rows; // of base_level - 1
+    uint64_t start_ns;
+    uint64_t proxy_ns;    // 0 until something real can be drawn
+    uint64_t resident_ns; // 0 until level 0 is in
+}TextureStream;
+
+bool texture_stream_open(TextureStream* stream, const char* image_path);
+/* Uploads up to budget bytes of the next finer level. Call once per frame. */
+void texture_stream_update(TextureStream* stream, size_t budget);
+/* Blocks until the whole chain is resident, for runs that need the final
+ * image from the first frame. */
+bool texture_stream_finish(TextureStream* stream);
+void texture_stream_close(TextureStream* stream);
+
+#endif // TEXTURE_STREAM_H
@@ -16,6 +16,29 @@ void transform_list_clear(TransformList* list)
     list->size = 0;
 }
 
+/* Product list[0] * list[1] * ... in the same order vertex.glsl applies them. */
+void transform_list_compose(const TransformList* list, float out[MATRIX_SIZE])
+{
+    assert(MATRIX_SIZE == 16);
+    float result[MATRIX_SIZE] = IDENTITY_MATRIX;
+    for (size_t i = 0; i < list->size; ++i)
+    {
+        const float* m = list->transformations[i];
+        float product[MATRIX_SIZE];
+        for (int r = 0; r < MATRIX_ROWS; ++r)
+        {
+            for (int c = 0; c < MATRIX_COLS; ++c)
+            {
+                product[r * MATRIX_COLS + c] = 0.0f;
+                for (int k = 0; k < MATRIX_COLS; ++k)
+                    product[r * MATRIX_COLS + c] += result[r * MATRIX_COLS + k] * m[k * MATRIX_COLS + c];
+            }
+        }
+        memcpy(result, product, sizeof(result));
+    }
+    memcpy(out, result, sizeof(result));
+}
+
 void rotate_cw_x(TransformList* list, float angle)
 {
     assert(MATRIX_SIZE == 16);
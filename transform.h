@@ -21,6 +21,7 @@ typedef struct TransformList
 
 void transform_list_push(TransformList*, float[MATRIX_SIZE]);
 void transform_list_clear(TransformList*);
+void transform_list_compose(const TransformList*, float[MATRIX_SIZE]);
 void rotate_cw_x(TransformList*, float);
 void rotate_ccw_x(TransformList*, float);
 void rotate_cw_y(TransformList*, float);
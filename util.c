@@ -1,33 +1,136 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "util.h"
 
-char* read_file(const char* file_path)
+#define READ_CHUNK (64 * 1024)
+
+static int access_to_advice(FileAccess access)
 {
-    FILE* file;
-    if ((file = fopen(file_path, "r")) == NULL)
+    switch (access)
     {
-        perror("Error reading file");
+    case FILE_ACCESS_RANDOM:
+        return MADV_RANDOM;
+    case FILE_ACCESS_WILLNEED:
+        return MADV_WILLNEED;
+    case FILE_ACCESS_SEQUENTIAL:
+    default:
+        return MADV_SEQUENTIAL;
+    }
+}
+
+/* Fallback for anything mmap refuses (pipes, procfs, zero sized files):
+ * read() straight into one growing heap buffer, no stdio buffering. */
+static bool read_fd(int fd, size_t size_hint, FileSpan* span)
+{
+    size_t capacity = size_hint ? size_hint : READ_CHUNK;
+    size_t size = 0;
+    char* data = malloc(capacity);
+    if (data == NULL)
+    {
+        perror("Error allocating memory");
         return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    size_t file_size = ftell(file); 
-    fseek(file, 0, SEEK_SET);
+    for (;;)
+    {
+        if (size == capacity)
+        {
+            capacity *= 2;
+            char* grown = realloc(data, capacity);
+            if (grown == NULL)
+            {
+                perror("Error allocating memory");
+                free(data);
+                return false;
+            }
+            data = grown;
+        }
 
-    char* file_contents = (char *)malloc(file_size + 1);
+        ssize_t bytes_read = read(fd, data + size, capacity - size);
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading file");
+            free(data);
+            return false;
+        }
+        if (bytes_read == 0)
+            break;
+        size += bytes_read;
+    }
+
+    span->data = data;
+    span->size = size;
+    span->mapped = false;
+    return true;
+}
 
-    if (file_contents == NULL)
+bool map_file(const char* file_path, FileSpan* span, FileAccess access)
+{
+    int fd;
+    if ((fd = open(file_path, O_RDONLY | O_CLOEXEC)) < 0)
     {
-        perror("Error allocating memory");
-        fclose(file);
+        perror("Error reading file");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("Error reading file");
+        close(fd);
         return false;
     }
 
-    size_t bytes_read = fread(file_contents, 1, file_size, file);
-    (file_contents)[bytes_read] = '\0';
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            madvise(addr, st.st_size, access_to_advice(access));
+            close(fd);
+            span->data = addr;
+            span->size = st.st_size;
+            span->mapped = true;
+            return true;
+        }
+    }
+
+    if (access == FILE_ACCESS_SEQUENTIAL || access == FILE_ACCESS_WILLNEED)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    bool ok = read_fd(fd, S_ISREG(st.st_mode) ? st.st_size : 0, span);
+    close(fd);
+    return ok;
+}
 
-    fclose(file);
-    return file_contents;
+void unmap_file(FileSpan* span)
+{
+    if (span->mapped)
+    {
+        munmap((void*) span->data, span->size);
+    }
+    else
+    {
+        free((void*) span->data);
+    }
+    span->data = NULL;
+    span->size = 0;
+    span->mapped = false;
+}
+
+uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
 }
@@ -2,7 +2,29 @@
 #define UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-char* read_file(const char* file_path);
+typedef enum FileAccess
+{
+    FILE_ACCESS_SEQUENTIAL, // read front to back once (shaders, images)
+    FILE_ACCESS_RANDOM,     // sparse reads (page files, caches)
+    FILE_ACCESS_WILLNEED,   // whole file needed soon, start read-ahead now
+}FileAccess;
+
+/* A read-only view of a file's contents. When mapped is true data points
+ * straight into the page cache, otherwise it is a heap copy filled with
+ * read(). The contents are not NUL terminated, always use size. */
+typedef struct FileSpan
+{
+    const char* data;
+    size_t size;
+    bool mapped;
+}FileSpan;
+
+bool map_file(const char* file_path, FileSpan* span, FileAccess access);
+void unmap_file(FileSpan* span);
+
+uint64_t time_now_ns(void);
 
 #endif // UTIL_H
@@ -1,23 +1,34 @@
 #version 330 core
+#include "common.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec2 aTexCoord;
 out vec2 TexCoord;
+#if USE_COLOR
 out vec3 Color;
-uniform mat4[10] model;
-uniform int model_count;
+#endif
+#if TEXTURE_FORMAT == TEXTURE_CUBE
+out vec3 Direction; // model space, what a cube map is sampled with
+#endif
+uniform mat4[MODEL_COUNT] model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+    // a constant trip count, the driver unrolls it
     mat4 model_transform = mat4(1.0);
-    for(int i=0; i<model_count; i++)
+    for(int i=0; i<MODEL_COUNT; i++)
     {
         model_transform = model_transform * model[i];
     }
     
     gl_Position = projection * view * model_transform * vec4(aPos, 1.0);
+#if USE_COLOR
     Color = aColor;
+#endif
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+#if TEXTURE_FORMAT == TEXTURE_CUBE
+    Direction = aPos;
+#endif
 }
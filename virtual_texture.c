@@ -0,0 +1,482 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "glad/glad.h"
+#include "stb_image.h"
+#include "mesh_cache.h"
+#include "mipmap.h"
+#include "virtual_texture.h"
+
+#define VT_FEEDBACK_SAMPLES 3
+
+static const GLenum channel_formats[] = {0, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+static const GLenum channel_internal_formats[] = {0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+
+static uint64_t align_page(uint64_t offset)
+{
+    return (offset + VT_PAGE_ALIGN - 1) & ~(uint64_t) (VT_PAGE_ALIGN - 1);
+}
+
+static size_t page_bytes(const VirtualTextureHeader* header)
+{
+    return (size_t) header->page_size * header->page_size * header->channels;
+}
+
+static const uint8_t* page_data(const VirtualTexture* vt, int page)
+{
+    return (const uint8_t*) vt->file.data + vt->header->page_data_offset + page * page_bytes(vt->header);
+}
+
+static void fill_page(uint8_t* page, const uint8_t* level, int width, int height, int channels, int tile_x, int tile_y)
+{
+    for (int y = 0; y < VT_PAGE_SIZE; ++y)
+    {
+        int sy = tile_y * VT_PAGE_PAYLOAD - VT_PAGE_BORDER + y;
+        sy = sy < 0 ? 0 : (sy >= height ? height - 1 : sy);
+        for (int x = 0; x < VT_PAGE_SIZE; ++x)
+        {
+            int sx = tile_x * VT_PAGE_PAYLOAD - VT_PAGE_BORDER + x;
+            sx = sx < 0 ? 0 : (sx >= width ? width - 1 : sx);
+            memcpy(page + ((size_t) y * VT_PAGE_SIZE + x) * channels,
+                   level + ((size_t) sy * width + sx) * channels, channels);
+        }
+    }
+}
+
+bool virtual_texture_bake(const char* image_path, const char* page_path)
+{
+    struct stat st;
+    FileSpan source;
+    if (stat(image_path, &st) != 0 || !map_file(image_path, &source, FILE_ACCESS_SEQUENTIAL))
+    {
+        perror("Error reading virtual texture source");
+        return false;
+    }
+
+    int width, height, channels;
+    uint8_t* level = stbi_load_from_memory((const stbi_uc*) source.data, (int) source.size, &width, &height, &channels, 0);
+    unmap_file(&source);
+    if (level == NULL)
+    {
+        fprintf(stderr, "Failed to decode %s\n", image_path);
+        return false;
+    }
+
+    VirtualTextureHeader header = {
+        .magic = VT_MAGIC,
+        .version = VT_VERSION,
+        .width = width,
+        .height = height,
+        .channels = channels,
+        .page_size = VT_PAGE_SIZE,
+        .page_border = VT_PAGE_BORDER,
+        .source_size = st.st_size,
+        .source_mtime = st.st_mtime,
+    };
+    int w = width, h = height;
+    for (;;)
+    {
+        assert(header.level_count < VT_MAX_LEVELS);
+        VirtualTextureLevel* info = &header.levels[header.level_count++];
+        info->width = w;
+        info->height = h;
+        info->tiles_x = (w + VT_PAGE_PAYLOAD - 1) / VT_PAGE_PAYLOAD;
+        info->tiles_y = (h + VT_PAGE_PAYLOAD - 1) / VT_PAGE_PAYLOAD;
+        info->first_page = header.page_count;
+        header.page_count += info->tiles_x * info->tiles_y;
+        if (info->tiles_x == 1 && info->tiles_y == 1)
+            break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    header.page_data_offset = align_page(sizeof(header));
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", page_path);
+    FILE* file;
+    if ((file = fopen(tmp_path, "wb")) == NULL)
+    {
+        perror("Error writing virtual texture");
+        stbi_image_free(level);
+        return false;
+    }
+
+    static const char zeros[VT_PAGE_ALIGN] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(zeros, 1, header.page_data_offset - sizeof(header), file) == header.page_data_offset - sizeof(header);
+
+    MipOptions mip_options = {
+        .filter = MIP_FILTER_BOX,
+        .color_space = MIP_COLOR_LINEAR,
+        .round_up = true,
+        .max_levels = header.level_count,
+    };
+    MipChain chain = {0};
+    ok = ok && mip_chain_build(&chain, level, width, height, channels, &mip_options);
+
+    uint8_t* page = malloc(page_bytes(&header));
+    assert(page);
+    for (uint32_t l = 0; ok && l < header.level_count; ++l)
+    {
+        const VirtualTextureLevel* info = &header.levels[l];
+        const MipLevel* mip = &chain.levels[l];
+        assert(mip->width == (int) info->width && mip->height == (int) info->height);
+        for (uint32_t y = 0; ok && y < info->tiles_y; ++y)
+        {
+            for (uint32_t x = 0; ok && x < info->tiles_x; ++x)
+            {
+                fill_page(page, mip->data, info->width, info->height, channels, x, y);
+                ok = fwrite(page, 1, page_bytes(&header), file) == page_bytes(&header);
+            }
+        }
+    }
+    free(page);
+    if (chain.level_count)
+        mip_chain_free(&chain);
+    stbi_image_free(level);
+
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, page_path) != 0)
+    {
+        perror("Error writing virtual texture");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+static bool open_pages(VirtualTexture* vt, const char* image_path, const char* page_path)
+{
+    struct stat source;
+    struct stat pages;
+    if (stat(image_path, &source) != 0 || stat(page_path, &pages) != 0)
+        return false;
+    if (!map_file(page_path, &vt->file, FILE_ACCESS_RANDOM))
+        return false;
+
+    const VirtualTextureHeader* header = (const VirtualTextureHeader*) vt->file.data;
+    if (vt->file.size < sizeof(VirtualTextureHeader)
+        || header->magic != VT_MAGIC
+        || header->version != VT_VERSION
+        || header->page_size != VT_PAGE_SIZE
+        || header->page_border != VT_PAGE_BORDER
+        || header->channels < 1 || header->channels > 4
+        || header->level_count < 1 || header->level_count > VT_MAX_LEVELS
+        || header->source_size != (uint64_t) source.st_size
+        || header->source_mtime != source.st_mtime
+        || header->page_data_offset + (uint64_t) header->page_count * page_bytes(header) > vt->file.size)
+    {
+        unmap_file(&vt->file);
+        return false;
+    }
+    vt->header = header;
+    return true;
+}
+
+static int allocate_slot(VirtualTexture* vt)
+{
+    int lru = -1;
+    for (int i = 0; i < VT_CACHE_SLOTS; ++i)
+    {
+        if (vt->slot_page[i] < 0)
+            return i;
+        if (vt->slot_used[i] < vt->frame && (lru < 0 || vt->slot_used[i] < vt->slot_used[lru]))
+            lru = i;
+    }
+    if (lru >= 0)
+    {
+        vt->page_slot[vt->slot_page[lru]] = -1;
+        vt->slot_page[lru] = -1;
+        vt->frame_stats.evictions++;
+    }
+    return lru;
+}
+
+static bool upload_page(VirtualTexture* vt, int page, uint32_t used)
+{
+    int slot = allocate_slot(vt);
+    if (slot < 0)
+        return false;
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    (slot % VT_CACHE_PAGES_X) * VT_PAGE_SIZE, (slot / VT_CACHE_PAGES_X) * VT_PAGE_SIZE,
+                    VT_PAGE_SIZE, VT_PAGE_SIZE, channel_formats[vt->header->channels], GL_UNSIGNED_BYTE,
+                    page_data(vt, page));
+    vt->slot_page[slot] = page;
+    vt->slot_used[slot] = used;
+    vt->page_slot[page] = slot;
+    vt->indirection_dirty = true;
+    vt->frame_stats.uploads++;
+    return true;
+}
+
+/* Finest resident level for every level 0 page. The top level is pinned so
+ * the search always terminates. */
+static void update_indirection(VirtualTexture* vt)
+{
+    const VirtualTextureHeader* header = vt->header;
+    const VirtualTextureLevel* base = &header->levels[0];
+    for (uint32_t y = 0; y < base->tiles_y; ++y)
+    {
+        for (uint32_t x = 0; x < base->tiles_x; ++x)
+        {
+            uint8_t* entry = vt->indirection + ((size_t) y * base->tiles_x + x) * 4;
+            for (uint32_t l = 0; l < header->level_count; ++l)
+            {
+                const VirtualTextureLevel* info = &header->levels[l];
+                int slot = vt->page_slot[info->first_page + (y >> l) * info->tiles_x + (x >> l)];
+                if (slot >= 0)
+                {
+                    entry[0] = slot % VT_CACHE_PAGES_X;
+                    entry[1] = slot / VT_CACHE_PAGES_X;
+                    entry[2] = l;
+                    entry[3] = 255;
+                    break;
+                }
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, vt->indirection_texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, base->tiles_x, base->tiles_y, GL_RGBA, GL_UNSIGNED_BYTE, vt->indirection);
+    vt->indirection_dirty = false;
+}
+
+bool virtual_texture_open(VirtualTexture* vt, const char* image_path)
+{
+    *vt = (VirtualTexture) {0};
+
+    const char* name = strrchr(image_path, '/');
+    name = name ? name + 1 : image_path;
+    char page_path[512];
+    snprintf(page_path, sizeof(page_path), MESH_CACHE_DIR "/%s.vt", name);
+
+    if (!open_pages(vt, image_path, page_path))
+    {
+        if (mkdir(MESH_CACHE_DIR, 0755) != 0 && errno != EEXIST)
+        {
+            perror("Error creating cache directory");
+            return false;
+        }
+        if (!virtual_texture_bake(image_path, page_path) || !open_pages(vt, image_path, page_path))
+            return false;
+    }
+
+    const VirtualTextureHeader* header = vt->header;
+    const VirtualTextureLevel* top = &header->levels[header->level_count - 1];
+    const VirtualTextureLevel* base = &header->levels[0];
+    assert(top->tiles_x * top->tiles_y <= VT_CACHE_SLOTS);
+
+    vt->page_slot = malloc(sizeof(int) * header->page_count);
+    vt->page_requested = calloc(header->page_count, sizeof(uint32_t));
+    vt->requests = malloc(sizeof(int) * header->page_count);
+    vt->indirection = calloc((size_t) base->tiles_x * base->tiles_y, 4);
+    assert(vt->page_slot && vt->page_requested && vt->requests && vt->indirection);
+    for (uint32_t i = 0; i < header->page_count; ++i)
+        vt->page_slot[i] = -1;
+    for (int i = 0; i < VT_CACHE_SLOTS; ++i)
+        vt->slot_page[i] = -1;
+    vt->frame = 1;
+
+    glGenTextures(1, &vt->cache_texture);
+    glBindTexture(GL_TEXTURE_2D, vt->cache_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, channel_internal_formats[header->channels],
+                 VT_CACHE_PAGES_X * VT_PAGE_SIZE, VT_CACHE_PAGES_X * VT_PAGE_SIZE, 0,
+                 channel_formats[header->channels], GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t i = 0; i < top->tiles_x * top->tiles_y; ++i)
+        upload_page(vt, top->first_page + i, UINT32_MAX);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glGenTextures(1, &vt->indirection_texture);
+    glBindTexture(GL_TEXTURE_2D, vt->indirection_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, base->tiles_x, base->tiles_y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    update_indirection(vt);
+
+    vt->total_stats = vt->frame_stats;
+    vt->frame_stats = (VirtualTextureStats) {0};
+    return true;
+}
+
+static void request_page(VirtualTexture* vt, int page)
+{
+    if (vt->page_requested[page] == vt->frame)
+        return;
+    vt->page_requested[page] = vt->frame;
+    vt->frame_stats.requests++;
+
+    int slot = vt->page_slot[page];
+    if (slot >= 0)
+    {
+        vt->frame_stats.hits++;
+        if (vt->slot_used[slot] != UINT32_MAX)
+            vt->slot_used[slot] = vt->frame;
+        return;
+    }
+    vt->frame_stats.misses++;
+    vt->requests[vt->request_count++] = page;
+}
+
+/* Requests the page and recurses into its four children while it is visible
+ * and one of its texels still covers more than a screen pixel. */
+static void feedback(VirtualTexture* vt, const VirtualTextureView* view, int level, uint32_t x, uint32_t y)
+{
+    const VirtualTextureHeader* header = vt->header;
+    const VirtualTextureLevel* info = &header->levels[level];
+    if (x >= info->tiles_x || y >= info->tiles_y)
+        return;
+
+    float span = (float) VT_PAGE_PAYLOAD * (1 << level);
+    float u0 = x * span / header->width;
+    float v0 = y * span / header->height;
+    float u1 = fminf((x + 1) * span / header->width, 1.0f);
+    float v1 = fminf((y + 1) * span / header->height, 1.0f);
+
+    bool visible = false;
+    float distance = INFINITY;
+    for (int j = 0; j < VT_FEEDBACK_SAMPLES; ++j)
+    {
+        for (int i = 0; i < VT_FEEDBACK_SAMPLES; ++i)
+        {
+            Vec3 p = earth_uv_to_pos(u0 + (u1 - u0) * i / (VT_FEEDBACK_SAMPLES - 1),
+                                     v0 + (v1 - v0) * j / (VT_FEEDBACK_SAMPLES - 1));
+            Vec3 to_eye = {view->eye.x - p.x, view->eye.y - p.y, view->eye.z - p.z};
+            if (p.x * to_eye.x + p.y * to_eye.y + p.z * to_eye.z > 0.0f)
+                visible = true;
+            distance = fminf(distance, sqrtf(to_eye.x * to_eye.x + to_eye.y * to_eye.y + to_eye.z * to_eye.z));
+        }
+    }
+    if (!visible)
+        return;
+
+    request_page(vt, info->first_page + y * info->tiles_x + x);
+    if (level == 0)
+        return;
+
+    float um = (u0 + u1) / 2, vm = (v0 + v1) / 2;
+    Vec3 a = earth_uv_to_pos(u0, vm), b = earth_uv_to_pos(u1, vm);
+    Vec3 c = earth_uv_to_pos(um, v0), d = earth_uv_to_pos(um, v1);
+    float extent_u = sqrtf(powf(b.x - a.x, 2) + powf(b.y - a.y, 2) + powf(b.z - a.z, 2));
+    float extent_v = sqrtf(powf(d.x - c.x, 2) + powf(d.y - c.y, 2) + powf(d.z - c.z, 2));
+    float texels_u = (u1 - u0) * header->width / (1 << level);
+    float texels_v = (v1 - v0) * header->height / (1 << level);
+    float texel_size = fmaxf(extent_u / texels_u, extent_v / texels_v);
+    if (texel_size <= distance * view->pixel_angle)
+        return;
+
+    for (uint32_t cy = 0; cy < 2; ++cy)
+        for (uint32_t cx = 0; cx < 2; ++cx)
+            feedback(vt, view, level - 1, 2 * x + cx, 2 * y + cy);
+}
+
+static int coarser_first(const void* a, const void* b)
+{
+    return *(const int*) b - *(const int*) a;
+}
+
+void virtual_texture_update(VirtualTexture* vt, const VirtualTextureView* view)
+{
+    const VirtualTextureHeader* header = vt->header;
+    const VirtualTextureLevel* top = &header->levels[header->level_count - 1];
+
+    vt->frame++;
+    vt->frame_stats = (VirtualTextureStats) {0};
+    vt->request_count = 0;
+    for (uint32_t y = 0; y < top->tiles_y; ++y)
+        for (uint32_t x = 0; x < top->tiles_x; ++x)
+            feedback(vt, view, header->level_count - 1, x, y);
+
+    // pages are stored finest level first, so coarser pages have larger indices
+    qsort(vt->requests, vt->request_count, sizeof(int), coarser_first);
+
+    glBindTexture(GL_TEXTURE_2D, vt->cache_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int uploaded = 0;
+    for (int i = 0; i < vt->request_count; ++i)
+    {
+        if (uploaded == VT_MAX_UPLOADS_PER_FRAME || !upload_page(vt, vt->requests[i], vt->frame))
+        {
+            vt->frame_stats.deferred += vt->request_count - i;
+            break;
+        }
+        uploaded++;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (vt->indirection_dirty)
+        update_indirection(vt);
+
+    vt->total_stats.requests += vt->frame_stats.requests;
+    vt->total_stats.hits += vt->frame_stats.hits;
+    vt->total_stats.misses += vt->frame_stats.misses;
+    vt->total_stats.uploads += vt->frame_stats.uploads;
+    vt->total_stats.evictions += vt->frame_stats.evictions;
+    vt->total_stats.deferred += vt->frame_stats.deferred;
+}
+
+VirtualTextureUniforms virtual_texture_uniforms(unsigned int program)
+{
+    return (VirtualTextureUniforms) {
+        .cache = glGetUniformLocation(program, "vt_cache"),
+        .indirection = glGetUniformLocation(program, "vt_indirection"),
+        .size = glGetUniformLocation(program, "vt_size"),
+        .page = glGetUniformLocation(program, "vt_page"),
+        .cache_size = glGetUniformLocation(program, "vt_cache_size"),
+    };
+}
+
+void virtual_texture_bind(VirtualTexture* vt, const VirtualTextureUniforms* uniforms, int cache_unit, int indirection_unit)
+{
+    glActiveTexture(GL_TEXTURE0 + cache_unit);
+    glBindTexture(GL_TEXTURE_2D, vt->cache_texture);
+    glActiveTexture(GL_TEXTURE0 + indirection_unit);
+    glBindTexture(GL_TEXTURE_2D, vt->indirection_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(uniforms->cache, cache_unit);
+    glUniform1i(uniforms->indirection, indirection_unit);
+    glUniform2f(uniforms->size, vt->header->width, vt->header->height);
+    glUniform3f(uniforms->page, VT_PAGE_PAYLOAD, VT_PAGE_SIZE, VT_PAGE_BORDER);
+    glUniform1f(uniforms->cache_size, VT_CACHE_PAGES_X * VT_PAGE_SIZE);
+}
+
+void virtual_texture_print_stats(const VirtualTexture* vt)
+{
+    const VirtualTextureStats* s = &vt->total_stats;
+    const VirtualTextureHeader* header = vt->header;
+    int resident = 0;
+    for (int i = 0; i < VT_CACHE_SLOTS; ++i)
+        resident += vt->slot_page[i] >= 0;
+
+    printf("virtual texture %ux%u, %u levels, %u pages (%.1f MB), cache %d/%d pages (%.1f MB)\n",
+           header->width, header->height, header->level_count, header->page_count,
+           header->page_count * page_bytes(header) / (1024.0 * 1024.0), resident, VT_CACHE_SLOTS,
+           VT_CACHE_SLOTS * page_bytes(header) / (1024.0 * 1024.0));
+    printf("  requests %lu, hits %lu, misses %lu (hit rate %.2f%%), uploads %lu, evictions %lu, deferred %lu\n",
+           s->requests, s->hits, s->misses, s->requests ? 100.0 * s->hits / s->requests : 0.0,
+           s->uploads, s->evictions, s->deferred);
+}
+
+void virtual_texture_close(VirtualTexture* vt)
+{
+    glDeleteTextures(1, &vt->cache_texture);
+    glDeleteTextures(1, &vt->indirection_texture);
+    free(vt->page_slot);
+    free(vt->page_requested);
+    free(vt->requests);
+    free(vt->indirection);
+    unmap_file(&vt->file);
+    *vt = (VirtualTexture) {0};
+}
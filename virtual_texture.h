@@ -0,0 +1,113 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "geom.h"
+#include "util.h"
+
+#define VT_MAGIC 0x31545456 // "VTT1"
+#define VT_VERSION 1
+#define VT_MAX_LEVELS 16
+#define VT_PAGE_SIZE 128
+#define VT_PAGE_BORDER 1
+#define VT_PAGE_PAYLOAD (VT_PAGE_SIZE - 2 * VT_PAGE_BORDER)
+#define VT_PAGE_ALIGN 4096
+#define VT_CACHE_PAGES_X 16
+#define VT_CACHE_SLOTS (VT_CACHE_PAGES_X * VT_CACHE_PAGES_X)
+#define VT_MAX_UPLOADS_PER_FRAME 16
+
+/* Level l is ceil(width / 2^l) texels wide, so a level l page covers
+ * exactly 2^l x 2^l level 0 pages and a single indirection entry per level 0
+ * page is enough to describe residency. */
+typedef struct VirtualTextureLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t first_page;
+}VirtualTextureLevel;
+
+/* Page file header. Pages follow at page_data_offset, level by level and row
+ * by row, each VT_PAGE_SIZE^2 * channels bytes including the border texels
+ * copied from neighbouring pages. */
+typedef struct VirtualTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t page_size;
+    uint32_t page_border;
+    uint32_t level_count;
+    uint32_t page_count;
+    uint32_t reserved;
+    uint64_t source_size;
+    int64_t source_mtime;
+    VirtualTextureLevel levels[VT_MAX_LEVELS];
+    uint64_t page_data_offset;
+}VirtualTextureHeader;
+
+typedef struct VirtualTextureStats
+{
+    uint64_t requests;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uploads;
+    uint64_t evictions;
+    uint64_t deferred; // misses left for a later frame by the upload budget
+}VirtualTextureStats;
+
+/* What the feedback pass needs to know about the camera. eye is in the
+ * sphere's model space, pixel_angle is the angle one screen pixel subtends. */
+typedef struct VirtualTextureView
+{
+    Vec3 eye;
+    float pixel_angle;
+}VirtualTextureView;
+
+/* Uniform locations of one program, looked up when the program is linked
+ * so binding only sets values. */
+typedef struct VirtualTextureUniforms
+{
+    int cache;
+    int indirection;
+    int size;
+    int page;
+    int cache_size;
+}VirtualTextureUniforms;
+
+typedef struct VirtualTexture
+{
+    FileSpan file;
+    const VirtualTextureHeader* header;
+    unsigned int cache_texture;
+    unsigned int indirection_texture;
+
+    int slot_page[VT_CACHE_SLOTS];
+    uint32_t slot_used[VT_CACHE_SLOTS];
+    int* page_slot;
+    uint32_t* page_requested;
+    int* requests;
+    int request_count;
+
+    uint8_t* indirection;
+    bool indirection_dirty;
+    uint32_t frame;
+
+    VirtualTextureStats frame_stats;
+    VirtualTextureStats total_stats;
+}VirtualTexture;
+
+bool virtual_texture_bake(const char* image_path, const char* page_path);
+bool virtual_texture_open(VirtualTexture* vt, const char* image_path);
+void virtual_texture_update(VirtualTexture* vt, const VirtualTextureView* view);
+VirtualTextureUniforms virtual_texture_uniforms(unsigned int program);
+void virtual_texture_bind(VirtualTexture* vt, const VirtualTextureUniforms* uniforms, int cache_unit, int indirection_unit);
+void virtual_texture_print_stats(const VirtualTexture* vt);
+void virtual_texture_close(VirtualTexture* vt);
+
+#endif // VIRTUAL_TEXTURE_H